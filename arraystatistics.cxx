@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include <vigra/hdf5impex.hxx>
+
+#include "arraystatistics.hxx"
+#include "blocking.h"
+#include "buffers.hxx"
+#include "compressors.hxx"
+#include "threadpool.hxx"
+
+namespace {
+
+/**
+ * compress all blocks of 'data' with all codecs that support it, print
+ * and write the totals per codec
+ */
+template<unsigned int N, class T>
+void runArray(const vigra::MultiArrayView<N, T>& data, const std::string& name,
+              const std::string& dtype, const ArrayOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl; using std::setw;
+    typedef typename BW::Roi<int(N)>::V V;
+
+    const int l = options.blockSize > 0
+        ? options.blockSize
+        : std::max(1, static_cast<int>(std::pow(64.0*64.0*64.0, 1.0/N) + 0.5));
+    const BW::Roi<int(N)> roi(V(), data.shape());
+    const BW::Blocking<int(N)> blocking(roi, V(l));
+    const std::vector<Codec> codecs = codecList<N, T>(options.filters);
+
+    ThreadPool pool(options.nthreads);
+    cout << "* compressing " << name << " (" << dtype << ", " << N << "-D, " << data.shape() << ") in "
+         << blocking.numBlocks() << " blocks of " << l << "^" << N << " with " << codecs.size()
+         << " codecs, nthreads = " << pool.size() << endl;
+
+    std::vector<CodecBuffers> codecBuffers(pool.size());
+    std::vector<ArrayVector<T> > blockBuffers(pool.size());
+    std::vector<std::vector<CompressionStatistics> > results(
+        blocking.numBlocks(), std::vector<CompressionStatistics>(codecs.size()));
+    for(size_t i=0; i<blocking.numBlocks(); ++i) {
+        pool.submit([&, i]() {
+            const int w = ThreadPool::currentWorker();
+            const BW::Roi<int(N)> blockRoi = blocking[i].second;
+            if(blockBuffers[w].size() < size_t(blockRoi.size())) {
+                blockBuffers[w].resize(blockRoi.size());
+            }
+            const MultiArrayView<N, T> a = extractBlock<T>(data, blockRoi, blockBuffers[w].data());
+            for(size_t c=0; c<codecs.size(); ++c) {
+                results[i][c] = statCompressor(a, codecs[c], options.codecThreads,
+                                               options.timing, codecBuffers[w]);
+            }
+        });
+    }
+    pool.wait();
+
+    std::ofstream file("array.txt", std::ios::trunc);
+    file /* 0 */ << "codec "
+         /* 1 */ << "dtype "
+         /* 2 */ << "dimension "
+         /* 3 */ << "blockSize "
+         /* 4 */ << "sizeBytesUncompressed "
+         /* 5 */ << "sizeBytesCompressed "
+         /* 6 */ << "compessionRatio "
+         /* 7 */ << "MBPerS_compress "
+         /* 8 */ << "MBPerS_uncompress"
+                 << endl;
+    cout << "# " << setw(30) << "codec" << " | " << setw(10) << "ratio"
+         << " | " << setw(12) << "compress" << " | " << setw(12) << "uncompress" << " (MB/s)" << endl;
+    for(size_t c=0; c<codecs.size(); ++c) {
+        double uncompressed = 0, compressed = 0, compressMs = 0, uncompressMs = 0;
+        for(size_t i=0; i<results.size(); ++i) {
+            const CompressionStatistics& s = results[i][c];
+            uncompressed += s.sizeBytesUncompressed;
+            compressed += s.sizeBytesCompressed;
+            compressMs += s.timeCompress;
+            uncompressMs += s.timeUncompress;
+        }
+        const double ratio = uncompressed > 0 ? compressed/uncompressed : 0.0;
+        cout << "  " << setw(30) << toString(codecs[c]) << " | " << setw(10) << ratio
+             << " | " << setw(12) << MBPerS(uncompressed, compressMs)
+             << " | " << setw(12) << MBPerS(uncompressed, uncompressMs) << endl;
+        file /* 0 */ << toString(codecs[c]) << " "
+             /* 1 */ << dtype << " "
+             /* 2 */ << N << " "
+             /* 3 */ << l << " "
+             /* 4 */ << uncompressed << " "
+             /* 5 */ << compressed << " "
+             /* 6 */ << ratio << " "
+             /* 7 */ << MBPerS(uncompressed, compressMs) << " "
+             /* 8 */ << MBPerS(uncompressed, uncompressMs)
+                     << endl;
+    }
+}
+
+template<unsigned int N, class T>
+void readAndRun(vigra::HDF5File& file, const std::string& dataset, const std::string& dtype,
+                const ArrayOptions& options) {
+    vigra::MultiArray<N, T> data;
+    file.readAndResize(dataset, data);
+    runArray<N, T>(data, dataset, dtype, options);
+}
+
+template<unsigned int N>
+void dispatchType(vigra::HDF5File& file, const std::string& dataset, const std::string& dtype,
+                  const ArrayOptions& options) {
+    if(dtype == "UINT8") {
+        readAndRun<N, uint8_t>(file, dataset, dtype, options);
+    }
+    else if(dtype == "UINT16") {
+        readAndRun<N, uint16_t>(file, dataset, dtype, options);
+    }
+    else if(dtype == "UINT32") {
+        readAndRun<N, uint32_t>(file, dataset, dtype, options);
+    }
+    else if(dtype == "UINT64") {
+        readAndRun<N, uint64_t>(file, dataset, dtype, options);
+    }
+    else {
+        throw std::runtime_error("arrayStatistics: " + dataset + " has type " + dtype
+                                 + ", expected UINT8, UINT16, UINT32 or UINT64");
+    }
+}
+
+} /* anonymous namespace */
+
+void arrayStatistics(const std::string& fileName, const std::string& dataset,
+                     const ArrayOptions& options) {
+    vigra::HDF5File file(fileName, vigra::HDF5File::OpenReadOnly);
+    const std::string dtype = file.getDatasetType(dataset);
+    switch(file.getDatasetDimensions(dataset)) {
+        case 2:
+        dispatchType<2>(file, dataset, dtype, options);
+        break;
+        case 3:
+        dispatchType<3>(file, dataset, dtype, options);
+        break;
+        case 4:
+        dispatchType<4>(file, dataset, dtype, options);
+        break;
+        default:
+        throw std::runtime_error("arrayStatistics: " + dataset + " must have 2, 3 or 4 dimensions");
+    }
+}
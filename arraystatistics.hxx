@@ -0,0 +1,45 @@
+#ifndef ARRAYSTATISTICS_HXX
+#define ARRAYSTATISTICS_HXX
+
+#include <string>
+#include <vector>
+
+#include "benchmark.hxx"
+#include "filters.hxx"
+
+struct ArrayOptions {
+    ArrayOptions()
+      : blockSize(0)
+      , nthreads(1)
+      , codecThreads(1)
+      , filters(1, NO_FILTER)
+      {}
+
+    /**
+     * edge length of the blocks, the same along every axis; 0 chooses
+     * the length for which a block has about 64^3 elements
+     */
+    int blockSize;
+    /** number of threads compressing blocks in parallel */
+    int nthreads;
+    /** number of threads each codec may use internally */
+    int codecThreads;
+    TimingOptions timing;
+    /**
+     * filters applied before each codec; only 3-D uint32 datasets can be
+     * filtered, for others the filtered codecs are skipped
+     */
+    std::vector<Filter> filters;
+};
+
+/**
+ * Compress the 2-, 3- or 4-dimensional unsigned integer dataset 'dataset'
+ * of the HDF5 file 'file' block by block with all codecs. The dataset is
+ * read with its own element type (uint8, uint16, uint32 or uint64), so
+ * sizes and throughputs are those of the data as stored. Prints the ratio
+ * and throughput per codec and writes them to array.txt.
+ */
+void arrayStatistics(const std::string& file, const std::string& dataset,
+                     const ArrayOptions& options);
+
+#endif /* ARRAYSTATISTICS_HXX */
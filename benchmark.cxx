@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "benchmark.hxx"
+
+namespace {
+    double percentileSorted(const std::vector<double>& samples, double q) {
+        if(samples.empty()) {
+            return 0.0;
+        }
+        const double pos = q*(samples.size()-1);
+        const size_t lo = static_cast<size_t>(std::floor(pos));
+        const size_t hi = std::min(lo+1, samples.size()-1);
+        const double w = pos - lo;
+        return (1.0-w)*samples[lo] + w*samples[hi];
+    }
+}
+
+double percentile(std::vector<double> samples, double q) {
+    std::sort(samples.begin(), samples.end());
+    return percentileSorted(samples, q);
+}
+
+TimingSummary summarize(std::vector<double>& samples) {
+    TimingSummary s;
+    if(samples.empty()) {
+        return s;
+    }
+    std::sort(samples.begin(), samples.end());
+    s.min    = samples.front();
+    s.median = percentileSorted(samples, 0.5);
+    s.p90    = percentileSorted(samples, 0.9);
+    s.p99    = percentileSorted(samples, 0.99);
+    s.runs   = samples.size();
+    return s;
+}
+
+double MBPerS(double bytes, double ms) {
+    return ms > 0.0 ? bytes/(1024.0*1024.0) / (ms/1000.0) : 0.0;
+}
+
+void flushCaches(size_t bytes) {
+    thread_local std::vector<char> buffer;
+    if(buffer.size() != bytes) {
+        buffer.assign(bytes, 0);
+    }
+    // write every cache line, then read it back so the compiler
+    // cannot drop the stores
+    volatile char sink = 0;
+    for(size_t i=0; i<buffer.size(); i+=64) {
+        buffer[i] += 1;
+    }
+    for(size_t i=0; i<buffer.size(); i+=64) {
+        sink += buffer[i];
+    }
+    (void)sink;
+}
+
+size_t residentBytes() {
+    // second field of statm: resident pages
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if(!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t peakResidentBytes() {
+    rusage u;
+    if(getrusage(RUSAGE_SELF, &u) != 0) {
+        return 0;
+    }
+    // ru_maxrss is in kB on Linux
+    return static_cast<size_t>(u.ru_maxrss) * 1024;
+}
@@ -0,0 +1,104 @@
+#ifndef BENCHMARK_HXX
+#define BENCHMARK_HXX
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+/**
+ * how often and under which cache conditions a measurement is repeated
+ */
+struct TimingOptions {
+    TimingOptions()
+      : warmup(0)
+      , repetitions(1)
+      , minTimeMs(0.0)
+      , coldCache(false)
+      , cacheFlushBytes(64*1024*1024)
+      {}
+
+    /** untimed runs before the first measurement */
+    int warmup;
+    /** minimum number of timed runs */
+    int repetitions;
+    /** keep repeating until the timed runs add up to at least this many ms */
+    double minTimeMs;
+    /**
+     * evict the data caches before every timed run. Only meaningful if
+     * nothing else runs concurrently (i.e. with a single worker thread).
+     */
+    bool coldCache;
+    /** size of the buffer streamed through to evict the caches */
+    size_t cacheFlushBytes;
+};
+
+/**
+ * order statistics of a set of run times (in ms)
+ */
+struct TimingSummary {
+    TimingSummary()
+      : min(0)
+      , median(0)
+      , p90(0)
+      , p99(0)
+      , runs(0)
+      {}
+
+    double min;
+    double median;
+    double p90;
+    double p99;
+    int runs;
+};
+
+/**
+ * q-th quantile (q in [0,1]) of 'samples', linearly interpolated
+ */
+double percentile(std::vector<double> samples, double q);
+
+/**
+ * order statistics of 'samples', which are sorted in place
+ */
+TimingSummary summarize(std::vector<double>& samples);
+
+/**
+ * throughput in MB/s of processing 'bytes' bytes in 'ms' ms; 0 if no time
+ * was measured
+ */
+double MBPerS(double bytes, double ms);
+
+/**
+ * evict the data caches of the calling thread's core by streaming through
+ * a thread-local buffer of 'bytes' bytes
+ */
+void flushCaches(size_t bytes);
+
+/**
+ * resident set size of this process in bytes (0 if unknown)
+ */
+size_t residentBytes();
+
+/**
+ * largest resident set size of this process so far in bytes
+ */
+size_t peakResidentBytes();
+
+/**
+ * monotonic wall clock with sub-microsecond resolution
+ */
+class Stopwatch {
+    public:
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+    void restart() { start_ = std::chrono::steady_clock::now(); }
+
+    double elapsedMs() const {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start_).count();
+    }
+
+    private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif /* BENCHMARK_HXX */
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <iterator>
+
+#include "blockcache.hxx"
+
+size_t BlockKeyHash::operator()(const BlockKey& k) const {
+    // FNV-1a style mixing of the coordinate and the codec
+    size_t h = 14695981039346656037ULL;
+    for(int d=0; d<3; ++d) {
+        h = (h ^ size_t(k.coord[d])) * 1099511628211ULL;
+    }
+    h = (h ^ size_t(k.codec.filter)) * 1099511628211ULL;
+    h = (h ^ size_t(k.codec.method)) * 1099511628211ULL;
+    return h;
+}
+
+BlockCache::BlockCache(size_t budgetBytes, int shards)
+    : budget_(budgetBytes)
+{
+    shards = std::max(1, shards);
+    shardBudget_ = budget_ / shards;
+    for(int i=0; i<shards; ++i) {
+        shards_.push_back(std::unique_ptr<Shard>(new Shard));
+    }
+}
+
+BlockCache::Shard& BlockCache::shard(const BlockKey& key) {
+    // the low bits of the hash also pick the hash table bucket, use the high ones
+    const size_t h = BlockKeyHash()(key);
+    return *shards_[(h >> (4*sizeof(size_t))) % shards_.size()];
+}
+
+BlockCache::Block BlockCache::get(const BlockKey& key, const Loader& load) {
+    Shard& s = shard(key);
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.map.find(key);
+        if(it != s.map.end()) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            ++s.counters.hits;
+            return it->second->second;
+        }
+        ++s.counters.misses;
+    }
+
+    std::shared_ptr<Buffer> buffer(new Buffer);
+    load(*buffer);
+    const size_t bytes = buffer->size()*sizeof(uint32_t);
+    if(bytes > shardBudget_) {
+        return buffer;
+    }
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.map.find(key);
+    if(it != s.map.end()) {
+        // loaded concurrently by another thread
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        return it->second->second;
+    }
+    s.lru.push_front(std::make_pair(key, Block(buffer)));
+    s.map[key] = s.lru.begin();
+    s.bytes += bytes;
+    evict(s);
+    return buffer;
+}
+
+void BlockCache::evict(Shard& s) {
+    while(s.bytes > shardBudget_ && !s.lru.empty()) {
+        const List::iterator last = std::prev(s.lru.end());
+        s.bytes -= last->second->size()*sizeof(uint32_t);
+        s.map.erase(last->first);
+        s.lru.erase(last);
+        ++s.counters.evictions;
+    }
+}
+
+BlockCache::Counters BlockCache::counters() const {
+    Counters c;
+    for(const auto& s : shards_) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        c.hits += s->counters.hits;
+        c.misses += s->counters.misses;
+        c.evictions += s->counters.evictions;
+        c.bytesResident += s->bytes;
+        c.blocksResident += s->lru.size();
+    }
+    return c;
+}
+
+void BlockCache::clear() {
+    for(const auto& s : shards_) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->lru.clear();
+        s->map.clear();
+        s->bytes = 0;
+        s->counters = Counters();
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef BLOCKCACHE_HXX
+#define BLOCKCACHE_HXX
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "blocking.h"
+#include "compressors.hxx"
+
+/**
+ * identifies a decompressed block: its block coordinate and the codec its
+ * payload was stored with
+ */
+struct BlockKey {
+    BlockKey() {}
+
+    BlockKey(const BW::Blocking<3>::V& c, const Codec& cd)
+      : coord(c)
+      , codec(cd)
+      {}
+
+    bool operator==(const BlockKey& other) const {
+        return coord == other.coord && codec == other.codec;
+    }
+
+    BW::Blocking<3>::V coord;
+    Codec codec;
+};
+
+struct BlockKeyHash {
+    size_t operator()(const BlockKey& k) const;
+};
+
+/**
+ * Thread-safe LRU cache of decompressed blocks with a byte budget.
+ *
+ * Keys are distributed over independent shards (each with its own lock,
+ * LRU list and budget/shards bytes), so concurrent lookups of different
+ * blocks rarely contend. Blocks are handed out as shared pointers and stay
+ * valid after being evicted.
+ */
+class BlockCache {
+    public:
+    typedef vigra::ArrayVector<uint32_t> Buffer;
+    typedef std::shared_ptr<const Buffer> Block;
+    /** decompress the block into the given buffer */
+    typedef std::function<void(Buffer&)> Loader;
+
+    struct Counters {
+        Counters()
+          : hits(0)
+          , misses(0)
+          , evictions(0)
+          , bytesResident(0)
+          , blocksResident(0)
+          {}
+
+        double hitRate() const {
+            return hits + misses > 0 ? double(hits) / (hits + misses) : 0.0;
+        }
+
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t bytesResident;
+        size_t blocksResident;
+    };
+
+    /**
+     * a cache holding at most 'budgetBytes' bytes of decompressed blocks,
+     * split over 'shards' shards
+     */
+    explicit BlockCache(size_t budgetBytes, int shards = 16);
+
+    /**
+     * the block for 'key'; on a miss, 'load' fills a new buffer (outside
+     * of any lock) which is then inserted. Blocks larger than a shard's
+     * budget are returned without being cached.
+     */
+    Block get(const BlockKey& key, const Loader& load);
+
+    /** sum of the counters of all shards */
+    Counters counters() const;
+
+    /** drop all blocks and reset the counters */
+    void clear();
+
+    size_t budgetBytes() const { return budget_; }
+
+    private:
+    typedef std::list<std::pair<BlockKey, Block> > List;
+
+    struct Shard {
+        Shard() : bytes(0) {}
+
+        mutable std::mutex mutex;
+        /** most recently used first */
+        List lru;
+        std::unordered_map<BlockKey, List::iterator, BlockKeyHash> map;
+        size_t bytes;
+        Counters counters;
+    };
+
+    Shard& shard(const BlockKey& key);
+    void evict(Shard& s);
+
+    size_t budget_;
+    size_t shardBudget_;
+    std::vector<std::unique_ptr<Shard> > shards_;
+};
+
+#endif /* BLOCKCACHE_HXX */
@@ -0,0 +1,124 @@
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <stdexcept>
+
+#include "blockdedup.hxx"
+#include "resultcache.hxx"
+
+std::string toString(const BlockKind k) {
+    switch(k) {
+        case UNIQUE_BLOCK:
+        return "unique";
+        case UNIFORM_BLOCK:
+        return "uniform";
+        case DUPLICATE_BLOCK:
+        return "duplicate";
+        case NUM_BLOCK_KINDS:
+        break;
+    }
+    return "";
+}
+
+bool isUniform(const uint32_t* labels, size_t n) {
+    const uint32_t v = labels[0];
+    size_t i = 1;
+#ifdef __SSE2__
+    // most non-uniform blocks differ within the first few vectors
+    const __m128i first = _mm_set1_epi32(static_cast<int>(v));
+    for(; i+16 <= n; i += 16) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(labels + i);
+        const __m128i e = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(p), first),
+                          _mm_cmpeq_epi32(_mm_loadu_si128(p+1), first)),
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(p+2), first),
+                          _mm_cmpeq_epi32(_mm_loadu_si128(p+3), first)));
+        if(_mm_movemask_epi8(e) != 0xFFFF) {
+            return false;
+        }
+    }
+#endif
+    for(; i<n; ++i) {
+        if(labels[i] != v) {
+            return false;
+        }
+    }
+    return true;
+}
+
+DedupIndex::DedupIndex() {
+    clear();
+}
+
+DedupIndex::Digest DedupIndex::digest(const vigra::MultiArrayView<3, uint32_t>& block) {
+    if(block.size() > 0 && block.stride(0) != 1) {
+        throw std::runtime_error("DedupIndex: block rows must be contiguous");
+    }
+    // the block is visited row by row, so that views into a larger array
+    // need not be copied first
+    const size_t row = block.shape(0);
+    const auto rowData = [&](vigra::MultiArrayIndex y, vigra::MultiArrayIndex z) {
+        return block.data() + y*block.stride(1) + z*block.stride(2);
+    };
+
+    Digest d = {0, 0, block.size() > 0};
+    for(vigra::MultiArrayIndex z=0; d.uniform && z<block.shape(2); ++z) {
+        for(vigra::MultiArrayIndex y=0; d.uniform && y<block.shape(1); ++y) {
+            const uint32_t* p = rowData(y, z);
+            d.uniform = p[0] == block.data()[0] && isUniform(p, row);
+        }
+    }
+    if(!d.uniform) {
+        const uint64_t shape[3] = {uint64_t(block.shape(0)), uint64_t(block.shape(1)), uint64_t(block.shape(2))};
+        d.a = hashBytes(shape, sizeof(shape));
+        d.b = hashBytes(shape, sizeof(shape), 1);
+        for(vigra::MultiArrayIndex z=0; z<block.shape(2); ++z) {
+            for(vigra::MultiArrayIndex y=0; y<block.shape(1); ++y) {
+                const uint32_t* p = rowData(y, z);
+                d.a = hashBytes(p, row*sizeof(uint32_t), d.a);
+                d.b = hashBytes(p, row*sizeof(uint32_t), d.b);
+            }
+        }
+    }
+    return d;
+}
+
+BlockKind DedupIndex::classify(const vigra::MultiArrayView<3, uint32_t>& block, uint64_t id,
+                               uint64_t& original) {
+    return classify(block.shape(), digest(block), id, original);
+}
+
+BlockKind DedupIndex::classify(const vigra::MultiArrayShape<3>::type& shape,
+                               const Digest& d, uint64_t id, uint64_t& original) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    BlockKind kind = UNIFORM_BLOCK;
+    if(!d.uniform) {
+        const Original o = {id, shape};
+        auto inserted = first_.insert(std::make_pair(d, o));
+        // the shape is part of the digest, so a different one is a collision
+        kind = !inserted.second && inserted.first->second.shape == shape ? DUPLICATE_BLOCK : UNIQUE_BLOCK;
+        original = kind == DUPLICATE_BLOCK ? inserted.first->second.id : id;
+    }
+    ++counts_[kind];
+    return kind;
+}
+
+void DedupIndex::rejectDuplicate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --counts_[DUPLICATE_BLOCK];
+    ++counts_[UNIQUE_BLOCK];
+}
+
+void DedupIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    first_.clear();
+    for(int k=0; k<NUM_BLOCK_KINDS; ++k) {
+        counts_[k] = 0;
+    }
+}
+
+size_t DedupIndex::count(BlockKind kind) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counts_[kind];
+}
@@ -0,0 +1,107 @@
+#ifndef BLOCKDEDUP_HXX
+#define BLOCKDEDUP_HXX
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <vigra/multi_array.hxx>
+
+/**
+ * how a block is (or would be) stored
+ */
+enum BlockKind {
+    /** compressed with a codec */
+    UNIQUE_BLOCK = 0,
+    /** all voxels have the same label, stored as that label */
+    UNIFORM_BLOCK = 1,
+    /** same content as an earlier block, stored as a reference to it */
+    DUPLICATE_BLOCK = 2,
+    NUM_BLOCK_KINDS
+};
+
+std::string toString(const BlockKind k);
+
+/**
+ * whether all 'n' > 0 labels equal labels[0]; stops at the first
+ * difference
+ */
+bool isUniform(const uint32_t* labels, size_t n);
+
+/**
+ * Classifies the blocks of one blocking as uniform, duplicate (of the
+ * first block seen with the same content) or unique. Blocks are
+ * identified by a 128 bit digest of their shape and voxels, two
+ * differently seeded 64 bit hashes; only the id and shape of each unique
+ * block are kept. Among n distinct blocks, two share a digest with a
+ * probability of about n^2/2^129 (below 1e-20 for a billion blocks);
+ * callers that can read the original back (BlockStoreWriter) confirm a
+ * duplicate and call rejectDuplicate() if it differs.
+ *
+ * classify() may be called concurrently, but which of several equal
+ * blocks becomes the original then depends on the timing; classify in
+ * block order for reproducible results.
+ */
+class DedupIndex {
+    public:
+    struct Digest {
+        uint64_t a;
+        uint64_t b;
+        bool uniform;
+
+        bool operator==(const Digest& other) const {
+            return a == other.a && b == other.b && uniform == other.uniform;
+        }
+    };
+
+    DedupIndex();
+
+    /**
+     * the digest of 'block', whose rows (along axis 0) must be contiguous,
+     * e.g. a subarray of a MultiArray; does not touch the index, so it may
+     * run in parallel with anything
+     */
+    static Digest digest(const vigra::MultiArrayView<3, uint32_t>& block);
+
+    /**
+     * classify block 'id' of shape 'shape', whose digest() is 'd'. For a
+     * DUPLICATE_BLOCK, 'original' is set to the id of the unique block
+     * with the same digest.
+     */
+    BlockKind classify(const vigra::MultiArrayShape<3>::type& shape,
+                       const Digest& d, uint64_t id, uint64_t& original);
+
+    /** classify(block.shape(), digest(block), id, original) */
+    BlockKind classify(const vigra::MultiArrayView<3, uint32_t>& block, uint64_t id,
+                       uint64_t& original);
+
+    /**
+     * count a block classified as a DUPLICATE_BLOCK as unique after all,
+     * since its voxels differ from the original's
+     */
+    void rejectDuplicate();
+
+    /** forget all blocks and reset the counts */
+    void clear();
+
+    /** number of blocks classified as 'kind' since the last clear() */
+    size_t count(BlockKind kind) const;
+
+    private:
+    struct DigestHash {
+        size_t operator()(const Digest& d) const { return d.a; }
+    };
+
+    /** the first block with a digest */
+    struct Original {
+        uint64_t id;
+        vigra::MultiArrayShape<3>::type shape;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<Digest, Original, DigestHash> first_;
+    size_t counts_[NUM_BLOCK_KINDS];
+};
+
+#endif /* BLOCKDEDUP_HXX */
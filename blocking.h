@@ -30,6 +30,8 @@
 #ifndef BW_BLOCKING_H
 #define BW_BLOCKING_H
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 #include <iostream>
 
@@ -39,6 +41,10 @@ namespace BW {
 
 /**
  * Computes a tiling of (possibly overlapping) blocks.
+ *
+ * The blocks are not stored: block i (in C-order over the block grid, i.e.
+ * with the last axis varying fastest) is computed from its index on demand,
+ * so a Blocking takes constant memory regardless of the number of blocks.
  */
 template<int N>
 class Blocking {
@@ -47,50 +53,213 @@ class Blocking {
 
     typedef std::pair<V, Roi<N> > Pair;
 
-    Blocking() {}
+    /**
+     * random access iterator over the blocks, dereferences to a Pair
+     * (block coordinate, block roi) by value
+     */
+    class const_iterator {
+        public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef Pair value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Pair* pointer;
+        typedef Pair reference;
+
+        const_iterator() : blocking_(0), i_(0) {}
+        const_iterator(const Blocking* blocking, size_t i) : blocking_(blocking), i_(i) {}
+
+        Pair operator*() const { return (*blocking_)[i_]; }
+        Pair operator[](difference_type k) const { return (*blocking_)[i_+k]; }
+
+        /** linear index of the current block */
+        size_t index() const { return i_; }
+
+        const_iterator& operator++() { ++i_; return *this; }
+        const_iterator& operator--() { --i_; return *this; }
+        const_iterator operator++(int) { const_iterator t = *this; ++i_; return t; }
+        const_iterator operator--(int) { const_iterator t = *this; --i_; return t; }
+        const_iterator& operator+=(difference_type k) { i_ += k; return *this; }
+        const_iterator& operator-=(difference_type k) { i_ -= k; return *this; }
+        const_iterator operator+(difference_type k) const { return const_iterator(blocking_, i_+k); }
+        const_iterator operator-(difference_type k) const { return const_iterator(blocking_, i_-k); }
+        difference_type operator-(const const_iterator& o) const {
+            return static_cast<difference_type>(i_) - static_cast<difference_type>(o.i_);
+        }
+
+        bool operator==(const const_iterator& o) const { return i_ == o.i_; }
+        bool operator!=(const const_iterator& o) const { return i_ != o.i_; }
+        bool operator< (const const_iterator& o) const { return i_ <  o.i_; }
+        bool operator> (const const_iterator& o) const { return i_ >  o.i_; }
+        bool operator<=(const const_iterator& o) const { return i_ <= o.i_; }
+        bool operator>=(const const_iterator& o) const { return i_ >= o.i_; }
+
+        private:
+        const Blocking* blocking_;
+        size_t i_;
+    };
+
+    /**
+     * contiguous sub-range [begin, end) of the block indices,
+     * e.g. the share of one of several parallel consumers
+     */
+    class Range {
+        public:
+        Range() {}
+        Range(const_iterator b, const_iterator e) : begin_(b), end_(e) {}
+
+        const_iterator begin() const { return begin_; }
+        const_iterator end() const { return end_; }
+        size_t size() const { return end_ - begin_; }
+        bool empty() const { return begin_ == end_; }
+
+        private:
+        const_iterator begin_;
+        const_iterator end_;
+    };
+
+    Blocking() : numBlocks_(0) {}
 
     Blocking(Roi<N> roi, V blockShape, V overlap = V() )
         : roi_(roi)
         , blockShape_(blockShape)
         , overlap_(overlap)
+        , numBlocks_(1)
     {
-
-        V blockP = blockGivenCoordinateP(roi.p);
-        V blockQ = blockGivenCoordinateQ(roi.q);
-
-        V x = roi.p;
-        int dim=N-1;
-        addBlock(x);
-        while(dim >= 0) {
-            while(dim >= 0) {
-                if(x[dim] >= blockQ[dim]-1) {
-                    x[dim] = blockP[dim];
-                    --dim;
-                    continue;
-                } else {
-                    ++x[dim];
-                    addBlock(x);
-                    break;
-                }
-            }
-            if(dim >= 0) {
-                dim = N-1;
+        blockP_ = blockGivenCoordinateP(roi.p);
+        blockQ_ = blockGivenCoordinateQ(roi.q);
+        for(int i=0; i<N; ++i) {
+            if(roi.q[i] <= roi.p[i]) {
+                numBlocks_ = 0;
+                blockQ_ = blockP_;
+                break;
             }
+            numBlocks_ *= blockQ_[i] - blockP_[i];
         }
     }
 
     size_t numBlocks() const {
-        return blocks_.size();
+        return numBlocks_;
+    }
+
+    size_t size() const {
+        return numBlocks_;
     }
 
-    void pprint() {
-        std::pair<V, Roi<N> > roi;
-        for(const auto& roi : blocks_) {
-            std::cout << roi.first << ": " << roi.second << std::endl;
+    /**
+     * the region this blocking tiles
+     */
+    const Roi<N>& roi() const { return roi_; }
+
+    const V& blockShape() const { return blockShape_; }
+
+    const V& overlap() const { return overlap_; }
+
+    /**
+     * block coordinates of the first block and one past the last block
+     */
+    const V& blockBegin() const { return blockP_; }
+    const V& blockEnd() const { return blockQ_; }
+
+    /**
+     * block coordinate and roi of the i-th block
+     */
+    Pair operator[](size_t i) const {
+        V x = blockCoordinate(i);
+        return std::make_pair(x, blockRoi(x));
+    }
+
+    /**
+     * block coordinate of the i-th block
+     */
+    V blockCoordinate(size_t i) const {
+        V x;
+        for(int d=N-1; d>=0; --d) {
+            const size_t extent = blockQ_[d] - blockP_[d];
+            x[d] = blockP_[d] + i % extent;
+            i /= extent;
         }
+        return x;
     }
 
-    std::vector< std::pair<V, Roi<N> > > blocks() const { return blocks_; }
+    /**
+     * linear index of the block with block coordinate 'x'
+     */
+    size_t blockIndex(V x) const {
+        size_t i = 0;
+        for(int d=0; d<N; ++d) {
+            i = i*(blockQ_[d] - blockP_[d]) + (x[d] - blockP_[d]);
+        }
+        return i;
+    }
+
+    /**
+     * region covered by the block with block coordinate 'x',
+     * extended by the overlap on the upper side and clipped to roi()
+     */
+    Roi<N> blockRoi(V x) const {
+        Roi<N> r;
+        for(int i=0; i<N; ++i) {
+            r.p[i] = std::max( x[i]*blockShape_[i], roi_.p[i] );
+            r.q[i] = std::min( (x[i]+1)*blockShape_[i]+overlap_[i], roi_.q[i] );
+        }
+        return r;
+    }
+
+    /**
+     * block coordinate of the block whose (non-overlapping) core
+     * contains 'coordinate'
+     */
+    V blockContaining(V coordinate) const {
+        return blockGivenCoordinateP(coordinate);
+    }
+
+    /**
+     * linear index of the block whose core contains 'coordinate',
+     * which must lie inside roi()
+     */
+    size_t indexOfBlockContaining(V coordinate) const {
+        return blockIndex(blockContaining(coordinate));
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, numBlocks_); }
+
+    /**
+     * the blocks with linear indices [b, e)
+     */
+    Range range(size_t b, size_t e) const {
+        return Range(const_iterator(this, b), const_iterator(this, e));
+    }
+
+    /**
+     * split all blocks into (at most) 'parts' contiguous ranges
+     * whose sizes differ by at most one
+     */
+    std::vector<Range> split(size_t parts) const {
+        std::vector<Range> ranges;
+        parts = std::max<size_t>(1, std::min(parts, numBlocks_));
+        size_t b = 0;
+        for(size_t k=0; k<parts; ++k) {
+            size_t e = b + numBlocks_/parts + (k < numBlocks_%parts ? 1 : 0);
+            ranges.push_back(range(b, e));
+            b = e;
+        }
+        return ranges;
+    }
+
+    void pprint() const {
+        for(const auto& block : *this) {
+            std::cout << block.first << ": " << block.second << std::endl;
+        }
+    }
+
+    /**
+     * all blocks as a vector; this materializes the whole tiling,
+     * prefer iterating over the Blocking itself
+     */
+    std::vector< std::pair<V, Roi<N> > > blocks() const {
+        return std::vector<Pair>(begin(), end());
+    }
 
     private:
 
@@ -106,20 +275,13 @@ class Blocking {
         return c;
     }
 
-    void addBlock(V x) {
-        Roi<N> r;
-        for(int i=0; i<N; ++i) {
-            r.p[i] = x[i]*blockShape_[i];
-            r.q[i] = std::min( (x[i]+1)*blockShape_[i]+overlap_[i], roi_.q[i] );
-        }
-        blocks_.push_back(std::make_pair(x, r) );
-    }
-
     Roi<N> roi_;
     V blockShape_;
     V overlap_;
 
-    std::vector< std::pair<V, Roi<N> > > blocks_;
+    V blockP_;
+    V blockQ_;
+    size_t numBlocks_;
 };
 
 } /* namespace BW */
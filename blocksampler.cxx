@@ -0,0 +1,35 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "blocksampler.hxx"
+
+BlockSampler::BlockSampler(
+    const vigra::MultiArrayView<3, uint32_t>& data,
+    const Codec& codec,
+    int nthreads,
+    int codecThreads,
+    const TimingOptions& timing
+)
+    : data_(data)
+    , codec_(codec)
+    , codecThreads_(codecThreads)
+    , timing_(timing)
+    , pool_(nthreads)
+    , codecBuffers_(pool_.size())
+{}
+
+std::vector<size_t> BlockSampler::sample(size_t numBlocks, size_t n) {
+    std::vector<size_t> order(numBlocks);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+    order.resize(std::min(n, numBlocks));
+    return order;
+}
+
+CompressionStatistics BlockSampler::measure(const BW::Roi<3>& roi) {
+    BlockBufferPool::Handle buffer = blockBuffers_.acquire(roi.size());
+    const vigra::MultiArrayView<3, uint32_t> a = extractBlock<uint32_t>(data_, roi, buffer->data());
+    return statCompressor(a, codec_, codecThreads_, timing_,
+                          codecBuffers_[ThreadPool::currentWorker()]);
+}
@@ -0,0 +1,58 @@
+#ifndef BLOCKSAMPLER_HXX
+#define BLOCKSAMPLER_HXX
+
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "benchmark.hxx"
+#include "buffers.hxx"
+#include "compressors.hxx"
+#include "roi.h"
+#include "threadpool.hxx"
+
+/**
+ * Measures one codec on sampled blocks of a volume, on a thread pool with
+ * per-worker codec buffers. Used by the modes that compare layouts on a
+ * random subset of blocks (the shape tuner and the halo benchmark).
+ */
+class BlockSampler {
+    public:
+    BlockSampler(const vigra::MultiArrayView<3, uint32_t>& data, const Codec& codec,
+                 int nthreads, int codecThreads, const TimingOptions& timing);
+
+    /**
+     * the first min(n, numBlocks) block indices of a fixed pseudo-random
+     * permutation of [0, numBlocks), so that the same numBlocks always
+     * gives the same sample
+     */
+    static std::vector<size_t> sample(size_t numBlocks, size_t n);
+
+    /**
+     * run f(k) for every k in [0, n) on the pool and wait for all of them
+     */
+    template<class F>
+    void forEach(size_t n, const F& f) {
+        for(size_t k=0; k<n; ++k) {
+            pool_.submit([&f, k]() { f(k); });
+        }
+        pool_.wait();
+    }
+
+    /**
+     * extract 'roi' of the volume and measure the codec on it; must run
+     * in a task of forEach()
+     */
+    CompressionStatistics measure(const BW::Roi<3>& roi);
+
+    private:
+    const vigra::MultiArrayView<3, uint32_t>& data_;
+    Codec codec_;
+    int codecThreads_;
+    TimingOptions timing_;
+    ThreadPool pool_;
+    std::vector<CodecBuffers> codecBuffers_;
+    BlockBufferPool blockBuffers_;
+};
+
+#endif /* BLOCKSAMPLER_HXX */
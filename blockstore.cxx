@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <set>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "blockstore.hxx"
+
+namespace {
+
+const char MAGIC[8] = {'C', 'G', 'P', 'B', 'L', 'K', 'S', '2'};
+
+/**
+ * first bytes of a block store file
+ */
+struct Header {
+    char magic[8];
+    int64_t p[3];
+    int64_t q[3];
+    int64_t blockShape[3];
+    int64_t overlap[3];
+    uint64_t numBlocks;
+    /** position of the index, a multiple of 8 */
+    uint64_t indexOffset;
+};
+
+} /* anonymous namespace */
+
+BlockStoreWriter::BlockStoreWriter(const std::string& fileName, const BW::Blocking<3>& blocking)
+    : fileName_(fileName)
+    , file_(fileName.c_str(), std::ios::binary | std::ios::trunc)
+    , readFd_(-1)
+    , blocking_(blocking)
+    , index_(blocking.numBlocks(), BlockStoreEntry())
+    , originals_(blocking.numBlocks(), 0)
+    , failed_(blocking.numBlocks(), false)
+    , offset_(sizeof(Header))
+    , closed_(false)
+{
+    if(!file_) {
+        throw std::runtime_error("BlockStoreWriter: could not open " + fileName_);
+    }
+    readFd_ = ::open(fileName.c_str(), O_RDONLY);
+    if(readFd_ < 0) {
+        throw std::runtime_error("BlockStoreWriter: could not open " + fileName_ + " for reading");
+    }
+    // placeholder, rewritten by close()
+    Header header = Header();
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+}
+
+BlockStoreWriter::~BlockStoreWriter() {
+    try {
+        close();
+    }
+    catch(...) {
+    }
+    ::close(readFd_);
+}
+
+void BlockStoreWriter::add(
+    size_t i,
+    const vigra::MultiArrayView<3, uint32_t>& block,
+    const Codec& codec,
+    CodecBuffers& buffers,
+    int nthreads
+) {
+    uint64_t original = 0;
+    BlockKind kind = block.isUnstrided() ? dedup_.classify(block, i, original) : UNIQUE_BLOCK;
+    if(kind == DUPLICATE_BLOCK && !sameAsStored(original, block, buffers, nthreads)) {
+        // the digests collide, the block is stored on its own
+        dedup_.rejectDuplicate();
+        kind = UNIQUE_BLOCK;
+    }
+    if(kind != UNIQUE_BLOCK) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        BlockStoreEntry& e = index_[i];
+        e.kind = kind;
+        if(kind == UNIFORM_BLOCK) {
+            e.value = *block.data();
+        }
+        // the original may not be written yet, close() copies its entry
+        originals_[i] = original;
+        return;
+    }
+
+    size_t filteredSize = 0;
+    try {
+        filteredSize = encodeBlock(block, codec, nthreads, buffers);
+    }
+    catch(...) {
+        // duplicates waiting for this payload store themselves instead
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            failed_[i] = true;
+        }
+        stored_.notify_all();
+        throw;
+    }
+    const vigra::ArrayVector<char>& payload = buffers.compressed;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        BlockStoreEntry& e = index_[i];
+        e.offset = offset_;
+        e.length = payload.size();
+        e.filteredSize = filteredSize;
+        e.filter = codec.filter;
+        e.method = codec.method;
+        e.kind = UNIQUE_BLOCK;
+        file_.write(payload.data(), payload.size());
+        offset_ += payload.size();
+    }
+    stored_.notify_all();
+}
+
+bool BlockStoreWriter::sameAsStored(
+    uint64_t original,
+    const vigra::MultiArrayView<3, uint32_t>& block,
+    CodecBuffers& buffers,
+    int nthreads
+) {
+    // the original was classified first, so its add() is already running
+    BlockStoreEntry o;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stored_.wait(lock, [&]() { return index_[original].offset != 0 || failed_[original]; });
+        if(failed_[original]) {
+            return false;
+        }
+        o = index_[original];
+        file_.flush();
+    }
+    const size_t bytes = block.size()*sizeof(uint32_t);
+    buffers.reserve(bytes);
+    buffers.compressed.resize(o.length);
+    if(pread(readFd_, buffers.compressed.data(), o.length, o.offset) != ssize_t(o.length)) {
+        return false;
+    }
+    decodeBlock<3, uint32_t>(buffers.compressed.data(), o.length, o.filteredSize, o.codec(),
+                             block.shape(), nthreads, buffers,
+                             reinterpret_cast<uint32_t*>(buffers.roundtrip.data()));
+    return std::memcmp(buffers.roundtrip.data(), block.data(), bytes) == 0;
+}
+
+void BlockStoreWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(closed_) {
+        return;
+    }
+    closed_ = true;
+
+    for(size_t i=0; i<index_.size(); ++i) {
+        BlockStoreEntry& e = index_[i];
+        if(e.kind == DUPLICATE_BLOCK) {
+            const BlockStoreEntry& o = index_[originals_[i]];
+            e.offset = o.offset;
+            e.length = o.length;
+            e.filteredSize = o.filteredSize;
+            e.filter = o.filter;
+            e.method = o.method;
+        }
+    }
+
+    const uint64_t indexOffset = (offset_ + 7) / 8 * 8;
+    const char padding[8] = {0};
+    file_.write(padding, indexOffset - offset_);
+    file_.write(reinterpret_cast<const char*>(index_.data()),
+                index_.size()*sizeof(BlockStoreEntry));
+
+    Header header = Header();
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    for(int d=0; d<3; ++d) {
+        header.p[d] = blocking_.roi().p[d];
+        header.q[d] = blocking_.roi().q[d];
+        header.blockShape[d] = blocking_.blockShape()[d];
+        header.overlap[d] = blocking_.overlap()[d];
+    }
+    header.numBlocks = index_.size();
+    header.indexOffset = indexOffset;
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    file_.close();
+    if(!file_) {
+        throw std::runtime_error("BlockStoreWriter: could not write " + fileName_);
+    }
+}
+
+uint64_t BlockStoreWriter::bytesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return offset_ - sizeof(Header);
+}
+
+BlockStore::BlockStore(const std::string& fileName)
+    : fd_(-1)
+    , data_(0)
+    , size_(0)
+    , index_(0)
+{
+    fd_ = ::open(fileName.c_str(), O_RDONLY);
+    if(fd_ < 0) {
+        throw std::runtime_error("BlockStore: could not open " + fileName);
+    }
+    struct stat st;
+    if(fstat(fd_, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+        ::close(fd_);
+        throw std::runtime_error("BlockStore: " + fileName + " is not a block store");
+    }
+    size_ = st.st_size;
+    void* m = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(m == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("BlockStore: could not map " + fileName);
+    }
+    data_ = static_cast<const char*>(m);
+
+    const Header& header = *reinterpret_cast<const Header*>(data_);
+    if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+       || header.indexOffset % 8 != 0
+       || header.indexOffset + header.numBlocks*sizeof(BlockStoreEntry) > size_)
+    {
+        munmap(const_cast<char*>(data_), size_);
+        ::close(fd_);
+        throw std::runtime_error("BlockStore: " + fileName + " is not a block store");
+    }
+    V p, q, blockShape, overlap;
+    bool valid = true;
+    for(int d=0; d<3; ++d) {
+        p[d] = header.p[d];
+        q[d] = header.q[d];
+        blockShape[d] = header.blockShape[d];
+        overlap[d] = header.overlap[d];
+        valid = valid && p[d] <= q[d] && blockShape[d] > 0 && overlap[d] >= 0;
+    }
+    if(!valid) {
+        munmap(const_cast<char*>(data_), size_);
+        ::close(fd_);
+        throw std::runtime_error("BlockStore: " + fileName + " is not a block store");
+    }
+    blocking_ = BW::Blocking<3>(BW::Roi<3>(p, q), blockShape, overlap);
+    index_ = reinterpret_cast<const BlockStoreEntry*>(data_ + header.indexOffset);
+
+    // read() trusts the entries, so check them all once
+    std::set<uint32_t> methods;
+    for(const auto& kv : compressorList()) {
+        methods.insert(uint32_t(kv.second));
+    }
+    valid = header.numBlocks == blocking_.numBlocks();
+    for(size_t i=0; valid && i<header.numBlocks; ++i) {
+        const BlockStoreEntry& e = index_[i];
+        if(e.kind >= NUM_BLOCK_KINDS) {
+            valid = false;
+        }
+        else if(e.offset != 0) {
+            valid = e.offset >= sizeof(Header)
+                 && e.offset <= header.indexOffset
+                 && e.length <= header.indexOffset - e.offset
+                 && e.filter <= BITPACK_FILTER
+                 && methods.count(e.method) == 1
+                 && isFilteredSize(Filter(e.filter), blocking_[i].second.size(), e.filteredSize);
+        }
+    }
+    if(!valid) {
+        munmap(const_cast<char*>(data_), size_);
+        ::close(fd_);
+        throw std::runtime_error("BlockStore: " + fileName + " has a corrupt index");
+    }
+}
+
+BlockStore::~BlockStore() {
+    munmap(const_cast<char*>(data_), size_);
+    ::close(fd_);
+}
+
+void BlockStore::read(size_t i, uint32_t* dest, CodecBuffers& buffers) const {
+    if(!contains(i)) {
+        throw std::runtime_error("BlockStore: block has not been stored");
+    }
+    const BlockStoreEntry& e = index_[i];
+    if(e.kind == UNIFORM_BLOCK) {
+        std::fill(dest, dest + blocking_[i].second.size(), e.value);
+        return;
+    }
+    decodeBlock<3, uint32_t>(data_ + e.offset, e.length, e.filteredSize, e.codec(),
+                             blocking_[i].second.shape(), 1, buffers, dest);
+}
+
+BW::Roi<3> BlockStore::read(const V& coord, vigra::MultiArray<3, uint32_t>& out,
+                            CodecBuffers& buffers) const {
+    const size_t i = blocking_.blockIndex(coord);
+    const BW::Roi<3> roi = blocking_.blockRoi(coord);
+    if(out.shape() != roi.shape()) {
+        out.reshape(roi.shape());
+    }
+    read(i, out.data(), buffers);
+    return roi;
+}
+
+AccessStatistics benchmarkBlockStore(const BlockStore& store, bool random, size_t accesses) {
+    AccessStatistics stat;
+
+    std::vector<size_t> stored;
+    size_t largest = 0;
+    for(size_t i=0; i<store.blocking().numBlocks(); ++i) {
+        if(store.contains(i)) {
+            stored.push_back(i);
+            largest = std::max<size_t>(largest, store.blocking()[i].second.size());
+        }
+    }
+    if(stored.empty()) {
+        return stat;
+    }
+
+    vigra::ArrayVector<uint32_t> dest(largest);
+    CodecBuffers buffers;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, stored.size()-1);
+
+    std::vector<double> times;
+    times.reserve(accesses);
+    for(size_t k=0; k<accesses; ++k) {
+        const size_t i = stored[random ? pick(rng) : k % stored.size()];
+        Stopwatch t;
+        store.read(i, dest.data(), buffers);
+        times.push_back(t.elapsedMs());
+        stat.totalMs += times.back();
+        stat.bytes += store.blocking()[i].second.size()*sizeof(uint32_t);
+    }
+    stat.latency = summarize(times);
+    return stat;
+}
@@ -0,0 +1,186 @@
+#ifndef BLOCKSTORE_HXX
+#define BLOCKSTORE_HXX
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "benchmark.hxx"
+#include "blockdedup.hxx"
+#include "blocking.h"
+#include "buffers.hxx"
+#include "compressors.hxx"
+
+/**
+ * where (and how) the compressed payload of one block is stored
+ */
+struct BlockStoreEntry {
+    /**
+     * position in the file, 0 if the block has not been stored or is
+     * uniform
+     */
+    uint64_t offset;
+    /** compressed size in bytes */
+    uint64_t length;
+    /** size after uncompressing, before the filter is inverted */
+    uint64_t filteredSize;
+    uint32_t filter;
+    uint32_t method;
+    /**
+     * a BlockKind; duplicates share the payload of the first block with
+     * the same content
+     */
+    uint32_t kind;
+    /** the label of a uniform block */
+    uint32_t value;
+
+    Codec codec() const {
+        return Codec(Filter(filter), vigra::CompressionMethod(method));
+    }
+};
+
+/**
+ * Writes the compressed sub-blocks of a BW::Blocking<3> into a single file.
+ *
+ * Layout: a header describing the blocking, the payloads in the order in
+ * which they were added, and an index with one BlockStoreEntry per block
+ * (in the order of the blocks' linear indices). Uniform blocks have no
+ * payload, and blocks with the same content as an earlier one refer to
+ * its payload. A block whose digest matches an earlier one is compared
+ * with the earlier block's decoded payload before it is stored as a
+ * reference.
+ *
+ * add() may be called concurrently; compression happens outside the lock.
+ */
+class BlockStoreWriter {
+    public:
+    BlockStoreWriter(const std::string& fileName, const BW::Blocking<3>& blocking);
+
+    /**
+     * calls close()
+     */
+    ~BlockStoreWriter();
+
+    /**
+     * compress 'block', the block with linear index 'i', with 'codec'
+     * and append it to the file, unless it is uniform or a duplicate
+     * (only detected for unstrided blocks, e.g. from extractBlock)
+     */
+    void add(size_t i, const vigra::MultiArrayView<3, uint32_t>& block,
+             const Codec& codec, CodecBuffers& buffers, int nthreads = 1);
+
+    /**
+     * write the index and the header; further calls do nothing
+     */
+    void close();
+
+    /** payload bytes written so far */
+    uint64_t bytesWritten() const;
+
+    /** number of blocks added as 'kind' */
+    size_t count(BlockKind kind) const { return dedup_.count(kind); }
+
+    private:
+    /**
+     * whether the payload of block 'original' decodes to 'block'; waits
+     * until that payload has been written
+     */
+    bool sameAsStored(uint64_t original, const vigra::MultiArrayView<3, uint32_t>& block,
+                      CodecBuffers& buffers, int nthreads);
+
+    std::string fileName_;
+    std::ofstream file_;
+    /** reads back the payloads of originals */
+    int readFd_;
+    BW::Blocking<3> blocking_;
+    std::vector<BlockStoreEntry> index_;
+    DedupIndex dedup_;
+    /** for duplicates, the block whose payload they share */
+    std::vector<uint64_t> originals_;
+    /** blocks whose add() failed, so their payload never appears */
+    std::vector<bool> failed_;
+    uint64_t offset_;
+    bool closed_;
+    mutable std::mutex mutex_;
+    /** notified whenever a payload has been written (or will not be) */
+    std::condition_variable stored_;
+};
+
+/**
+ * Read-only, memory mapped view of a file written by BlockStoreWriter.
+ *
+ * Decompressing blocks only reads from the mapping, so a BlockStore may be
+ * shared by several threads as long as each uses its own CodecBuffers.
+ */
+class BlockStore {
+    public:
+    typedef BW::Blocking<3>::V V;
+
+    explicit BlockStore(const std::string& fileName);
+    ~BlockStore();
+
+    BlockStore(const BlockStore&) = delete;
+    BlockStore& operator=(const BlockStore&) = delete;
+
+    const BW::Blocking<3>& blocking() const { return blocking_; }
+
+    const BlockStoreEntry& entry(size_t i) const { return index_[i]; }
+
+    bool contains(size_t i) const {
+        return index_[i].offset != 0 || index_[i].kind == UNIFORM_BLOCK;
+    }
+
+    /** size of the mapped file in bytes */
+    size_t sizeBytes() const { return size_; }
+
+    /**
+     * decompress block 'i' to 'dest', which must have room for
+     * blocking()[i].second.size() elements
+     */
+    void read(size_t i, uint32_t* dest, CodecBuffers& buffers) const;
+
+    /**
+     * decompress the block at block coordinate 'coord' into 'out'
+     * (reshaped if needed)
+     *
+     * returns: the region of the volume covered by the block
+     */
+    BW::Roi<3> read(const V& coord, vigra::MultiArray<3, uint32_t>& out,
+                    CodecBuffers& buffers) const;
+
+    private:
+    int fd_;
+    const char* data_;
+    size_t size_;
+    BW::Blocking<3> blocking_;
+    const BlockStoreEntry* index_;
+};
+
+/**
+ * latencies of decompressing single blocks from a BlockStore
+ */
+struct AccessStatistics {
+    AccessStatistics()
+      : totalMs(0)
+      , bytes(0)
+      {}
+
+    /** per-block latency in ms */
+    TimingSummary latency;
+    double totalMs;
+    /** uncompressed bytes produced */
+    double bytes;
+};
+
+/**
+ * decompress 'accesses' stored blocks, either in order of their linear
+ * index (wrapping around) or uniformly at random
+ */
+AccessStatistics benchmarkBlockStore(const BlockStore& store, bool random, size_t accesses);
+
+#endif /* BLOCKSTORE_HXX */
@@ -0,0 +1,62 @@
+#include <algorithm>
+
+#include "buffers.hxx"
+#include "trace.hxx"
+
+size_t compressBound(size_t bytes) {
+    // zlib:  n + n/4096 + n/16384 + n/33554432 + 13
+    // LZ4:   n + n/255 + 16
+    // blosc: n + 16 (header)
+    return bytes + bytes/255 + 64;
+}
+
+void CodecBuffers::reserve(size_t bytes, size_t filteredBytes) {
+    const size_t bound = compressBound(std::max(bytes, filteredBytes));
+    if(compressed.capacity() < bound) {
+        compressed.reserve(bound);
+        ++growths;
+        trace::add(trace::ALLOCATIONS, 1);
+    }
+    if(roundtrip.size() < bytes) {
+        roundtrip.resize(bytes);
+        ++growths;
+        trace::add(trace::ALLOCATIONS, 1);
+    }
+    if(filtered.size() < filteredBytes) {
+        filtered.resize(filteredBytes);
+        ++growths;
+        trace::add(trace::ALLOCATIONS, 1);
+    }
+}
+
+BlockBufferPool::Handle BlockBufferPool::acquire(size_t elements) {
+    Buffer* b = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!free_.empty()) {
+            b = free_.back().release();
+            free_.pop_back();
+        }
+        else {
+            ++allocated_;
+        }
+    }
+    if(!b) {
+        b = new Buffer;
+    }
+    if(b->size() < elements) {
+        b->resize(elements);
+        trace::add(trace::ALLOCATIONS, 1);
+    }
+    return Handle(b, [this](Buffer* p) { release(p); });
+}
+
+size_t BlockBufferPool::allocated() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocated_;
+}
+
+void BlockBufferPool::release(Buffer* b) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(std::unique_ptr<Buffer>(b));
+}
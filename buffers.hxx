@@ -0,0 +1,94 @@
+#ifndef BUFFERS_HXX
+#define BUFFERS_HXX
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "roi.h"
+#include "trace.hxx"
+
+/**
+ * upper bound on the compressed size of 'bytes' bytes for any codec in
+ * compressorList() (the largest of the zlib, LZ4 and blosc bounds)
+ */
+size_t compressBound(size_t bytes);
+
+/**
+ * Destination and round-trip buffers for statCompressor.
+ *
+ * The buffers only ever grow, so once they have been reserved for the
+ * largest block, compressing further blocks does not allocate.
+ */
+struct CodecBuffers {
+    CodecBuffers() : growths(0) {}
+
+    /**
+     * make sure a block of 'bytes' uncompressed bytes fits,
+     * which takes 'filteredBytes' bytes after filtering
+     */
+    void reserve(size_t bytes, size_t filteredBytes = 0);
+
+    vigra::ArrayVector<char> compressed;
+    vigra::ArrayVector<char> roundtrip;
+    /** input of the codec if the block is filtered first */
+    vigra::ArrayVector<char> filtered;
+    std::vector<double> timesCompress;
+    std::vector<double> timesUncompress;
+    std::vector<double> timesFilter;
+    std::vector<double> timesUnfilter;
+    /** how often reserve() had to allocate */
+    size_t growths;
+};
+
+/**
+ * Thread-safe pool of block extraction buffers.
+ *
+ * acquire() hands out a buffer which returns to the pool when the last copy
+ * of the handle is destroyed. The pool must outlive all handles.
+ */
+class BlockBufferPool {
+    public:
+    typedef vigra::ArrayVector<uint32_t> Buffer;
+    typedef std::shared_ptr<Buffer> Handle;
+
+    BlockBufferPool() : allocated_(0) {}
+
+    /**
+     * a buffer with room for at least 'elements' elements
+     */
+    Handle acquire(size_t elements);
+
+    /** number of buffers created so far */
+    size_t allocated() const;
+
+    private:
+    void release(Buffer* b);
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Buffer> > free_;
+    size_t allocated_;
+};
+
+/**
+ * copy the (strided) sub-array 'roi' of 'src' into the contiguous memory at
+ * 'dest', which must have room for roi.size() elements.
+ *
+ * returns: an unstrided view of the copy
+ */
+template<class T, unsigned int N, class Tag>
+vigra::MultiArrayView<N, T> extractBlock(
+    const vigra::MultiArrayView<N, T, Tag>& src,
+    const BW::Roi<int(N)>& roi,
+    T* dest
+) {
+    TRACE_SPAN("extract");
+    vigra::MultiArrayView<N, T> block(roi.shape(), dest);
+    block.copy(src.subarray(roi.p, roi.q));
+    trace::add(trace::BYTES_EXTRACTED, roi.size()*sizeof(T));
+    return block;
+}
+
+#endif /* BUFFERS_HXX */
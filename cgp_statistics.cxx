@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <iomanip>
 #include <map>
+#include <sstream>
 #include <thread>
 
 #include <boost/program_options.hpp>
@@ -9,8 +11,44 @@
 #include <vigra/timing.hxx>
 
 #include "supervoxels.hxx"
+#include "arraystatistics.hxx"
 #include "compressors.hxx"
-#include "blocking.h"
+#include "cwxstatistics.hxx"
+#include "filters.hxx"
+#include "halostatistics.hxx"
+#include "rawvolume.hxx"
+#include "tgstatistics.hxx"
+#include "storestatistics.hxx"
+#include "shapetuner.hxx"
+#include "shards.hxx"
+#include "trace.hxx"
+
+namespace {
+
+/**
+ * parse the comma separated integers in 's', all at least 'minimum';
+ * false if 's' is empty or any of them is not such an integer
+ */
+bool intsFromString(const std::string& s, int minimum, std::vector<int>& values) {
+    std::vector<int> r;
+    std::stringstream ss(s);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        std::istringstream in(item);
+        int v;
+        if(!(in >> v) || !in.eof() || v < minimum) {
+            return false;
+        }
+        r.push_back(v);
+    }
+    if(r.empty()) {
+        return false;
+    }
+    values = r;
+    return true;
+}
+
+} /* anonymous namespace */
 
 int main(int argc, char** argv) {
     namespace po = boost::program_options;
@@ -22,14 +60,120 @@ int main(int argc, char** argv) {
         ("help", "produce help message")
         ("geom", po::value<std::string>(),
          "geometry file")
+        ("fastGeom", "open --geom without query indices and print the 1-, 2- and "
+         "3-set size distributions, computed on --threads workers")
         ("seg", po::value<std::string>(),
          "seg file")
         ("tg", po::value<std::string>(),
          "tg file")
         ("cwx", po::value<std::string>(),
-         "cwx file")
+         "cwx file: compress the whole 'cwx' dataset chunk by chunk with all codecs "
+         "(results written to cwx.txt)")
+        ("cwxL", po::value<int>(),
+         "edge length of the chunks compressed with --cwx (default: 128)")
+        ("array", po::value<std::string>(),
+         "file.h5/dataset: compress a 2-, 3- or 4-D uint8/16/32/64 dataset block by block "
+         "with all codecs, in its own element type (results written to array.txt)")
+        ("arrayL", po::value<int>(),
+         "edge length of the blocks compressed with --array (default: about 64^3 elements per block)")
         ("maxTgBlocks", po::value<int>(),
          "maximum number of tg blocks considered")
+        ("shard", po::value<std::string>(),
+         "i/N: measure only part i of N of the tg blocks (or of their sub-blocks if "
+         "there are fewer than N), e.g. one part per cluster node; combine with --merge")
+        ("processes", po::value<int>(),
+         "split the tg benchmark into this many shards run as local processes and "
+         "merge their results (--threads is per process, default: cores/processes)")
+        ("cache", po::value<std::string>(),
+         "persistent result cache of the tg benchmark: measurements of sub-blocks with "
+         "the same content, codec and timing options are reused, so interrupted or "
+         "repeated runs only compute what is missing")
+        ("checkpoint", po::value<double>(),
+         "write new --cache entries at least every this many seconds (default: 30)")
+        ("dedup", "skip uniform tg sub-blocks and repeats of earlier ones (per dataset and L) "
+         "and record them with the size of a constant encoding (result column 'kind'); "
+         "shards that split the sub-blocks do so by content")
+        ("merge", po::value<std::string>(),
+         "comma separated result files of --shard runs to combine into --results (and --csv)")
+        ("threads", po::value<int>(),
+         "number of worker threads for the tg benchmark (default: all cores)")
+        ("codecThreads", po::value<int>(),
+         "number of threads per codec invocation (default: cores/threads)")
+        ("warmup", po::value<int>(),
+         "untimed runs per codec and block before measuring (default: 0)")
+        ("repetitions", po::value<int>(),
+         "minimum number of timed runs per codec and block (default: 1)")
+        ("minTime", po::value<double>(),
+         "repeat until the timed runs take at least this many ms (default: 0)")
+        ("coldCache", "evict the caches before every timed run")
+        ("stream", "read the tg datasets brick by brick instead of loading them whole")
+        ("memoryBudget", po::value<int>(),
+         "maximum size of one brick in MB with --stream, and of the bricks "
+         "of the segmentation read with --seg (default: 1024)")
+        ("prefetch", po::value<int>(),
+         "read this many tg datasets/bricks ahead on a background thread (default: 0)")
+        ("readThreads", po::value<int>(),
+         "threads reading and decoding chunks when --tg is a chunked volume directory (default: 1)")
+        ("convert", po::value<std::string>(),
+         "write the datasets of --tg to this directory of memory-mappable raw or chunked "
+         "volumes, which --tg then accepts instead of the HDF5 file")
+        ("convertChunks", po::value<int>(),
+         "edge length of the chunk files written by --convert; 0 writes one raw file per "
+         "dataset (default: 0)")
+        ("convertCodec", po::value<std::string>(),
+         "codec of the chunks written by --convert, RAW or e.g. LZ4 (default: RAW)")
+        ("filters", po::value<std::string>(),
+         "comma separated filters applied before the codecs, or 'all' "
+         "(delta, xor, bitshuffle, lattice, bitpack); unfiltered codecs are always measured")
+        ("select", po::value<std::string>(),
+         "also pick a codec per tg sub-block from a compressed sample: 'ratio:<MB/s>' "
+         "maximizes the ratio with at least this decompression speed, 'speed:<fraction>' "
+         "maximizes the decompression speed with at most this compressed size fraction")
+        ("selectSample", po::value<double>(),
+         "fraction of the z-slices of a sub-block compressed by --select (default: 0.125)")
+        ("results", po::value<std::string>(),
+         "binary file receiving the tg benchmark results (default: stat.bin)")
+        ("csv", po::value<std::string>(),
+         "additionally export the tg benchmark results as text to this file")
+        ("store", po::value<std::string>(),
+         "block store file: with --tg, write the first tg dataset to it instead of "
+         "running the codec sweep; then measure random access latencies")
+        ("storeL", po::value<int>(),
+         "edge length of the blocks written with --store (default: 64)")
+        ("storeCodec", po::value<std::string>(),
+         "codec the blocks are written with, e.g. LZ4 or DELTA+LZ4 (default: LZ4)")
+        ("accesses", po::value<int>(),
+         "number of blocks decompressed per access pattern with --store (default: 1000)")
+        ("roiQuery", "with --tg and --store, sweep L and the ROI size and measure "
+         "ROI query latencies (written to roiquery.txt)")
+        ("tune", "with --tg, search block shapes and halos for the first tg dataset and "
+         "print the Pareto front of size and throughput (all candidates written to tuner.txt)")
+        ("tuneCodec", po::value<std::string>(),
+         "codec the candidates of --tune are measured with (default: LZ4)")
+        ("tuneHalos", po::value<std::string>(),
+         "comma separated halo widths tried by --tune (default: 0,1,2,4)")
+        ("halo", "with --tg, compare storing blocks with halos (whole, or as core plus halo "
+         "slabs) against reassembling the halos from neighbouring blocks at read time, "
+         "for the first tg dataset (written to halo.txt)")
+        ("haloL", po::value<std::string>(),
+         "comma separated core edge lengths measured by --halo (default: 32,64,128)")
+        ("haloWidths", po::value<std::string>(),
+         "comma separated halo widths measured by --halo (default: 1,2,4)")
+        ("haloCodec", po::value<std::string>(),
+         "codec the layouts of --halo are measured with (default: LZ4)")
+        ("chromeTrace", po::value<std::string>(),
+         "trace reading, extraction, compression and result writing per thread and "
+         "write the spans to this file (for chrome://tracing or ui.perfetto.dev)")
+        ("traceSummary", "trace as with --chromeTrace, but only print the summary table")
+        ("replay", po::value<std::string>(),
+         "with --store, replay the ROI queries of this trace file through the block cache")
+        ("cacheMB", po::value<std::string>(),
+         "comma separated block cache sizes in MB for --replay, 0 means no cache "
+         "(default: 0,64,256,1024)")
+        ("countKernel", po::value<std::string>(),
+         "how --seg counts voxels per label: runs, scalar or accumulator (default: runs)")
+        ("validateCounts", "with --seg, check the label counts against the accumulator")
+        ("countBenchmark", "with --seg, time every count kernel on the first brick")
     ;
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -40,7 +184,17 @@ int main(int argc, char** argv) {
     std::string segGroup;
     std::string tgFile;
     std::string cwxFile;
-    int maxTgBlocks = 10;
+    int cwxChunkSize = 128;
+    std::string arrayFile;
+    std::string arrayDataset;
+    ArrayOptions arrayOptions;
+    TgOptions tgOptions;
+    StoreOptions storeOptions;
+    SupervoxelOptions svOptions;
+    GeometryOptions geomOptions;
+    TunerOptions tunerOptions;
+    HaloOptions haloOptions;
+    tgOptions.nthreads = std::max(1u, std::thread::hardware_concurrency());
     
     if (vm.count("help")) {
         cout << desc << endl;
@@ -55,6 +209,22 @@ int main(int argc, char** argv) {
     if (vm.count("cwx")) {
         cwxFile = vm["cwx"].as<std::string>();
     } 
+    if (vm.count("cwxL")) {
+        cwxChunkSize = std::max(1, vm["cwxL"].as<int>());
+    }
+    if (vm.count("array")) {
+        std::string s = vm["array"].as<std::string>();
+        auto pos = s.find_last_of("/");
+        if(pos == std::string::npos) {
+            cout << "Error: --array must be of the form file.h5/dataset" << endl;
+            return 1;
+        }
+        arrayFile = s.substr(0,pos);
+        arrayDataset = s.substr(pos+1,s.size());
+    }
+    if (vm.count("arrayL")) {
+        arrayOptions.blockSize = std::max(1, vm["arrayL"].as<int>());
+    }
     if (vm.count("seg")) {
         std::string s = vm["seg"].as<std::string>();
         auto pos = s.find_last_of("/");
@@ -62,9 +232,210 @@ int main(int argc, char** argv) {
         segGroup = s.substr(pos+1,s.size());
     } 
     if (vm.count("maxTgBlocks")) {
-        maxTgBlocks = vm["maxTgBlocks"].as<int>();
+        tgOptions.maxBlocks = vm["maxTgBlocks"].as<int>();
+    }
+    int processes = 1;
+    if (vm.count("processes")) {
+        processes = std::max(1, vm["processes"].as<int>());
+        tgOptions.nthreads = std::max(1, tgOptions.nthreads/processes);
+    }
+    if (vm.count("threads")) {
+        tgOptions.nthreads = std::max(1, vm["threads"].as<int>());
+    }
+    if (vm.count("shard")) {
+        const std::string spec = vm["shard"].as<std::string>();
+        if(!shardFromString(spec, tgOptions.shard)) {
+            cout << "Error: --shard expects i/N with 0 <= i < N, not '" << spec << "'" << endl;
+            return 1;
+        }
+    }
+    tgOptions.codecThreads = std::max(1, (int)std::thread::hardware_concurrency()/(tgOptions.nthreads*processes));
+    if (vm.count("codecThreads")) {
+        tgOptions.codecThreads = std::max(1, vm["codecThreads"].as<int>());
+    }
+    if (vm.count("warmup")) {
+        tgOptions.timing.warmup = std::max(0, vm["warmup"].as<int>());
+    }
+    if (vm.count("repetitions")) {
+        tgOptions.timing.repetitions = std::max(1, vm["repetitions"].as<int>());
+    }
+    if (vm.count("minTime")) {
+        tgOptions.timing.minTimeMs = vm["minTime"].as<double>();
+    }
+    if (vm.count("coldCache")) {
+        tgOptions.timing.coldCache = true;
+    }
+    if (vm.count("stream")) {
+        tgOptions.streaming = true;
+    }
+    if (vm.count("memoryBudget")) {
+        tgOptions.memoryBudget = size_t(std::max(1, vm["memoryBudget"].as<int>())) << 20;
+    }
+    if (vm.count("prefetch")) {
+        tgOptions.prefetch = std::max(0, vm["prefetch"].as<int>());
+    }
+    if (vm.count("readThreads")) {
+        tgOptions.readThreads = std::max(1, vm["readThreads"].as<int>());
+    }
+    if (vm.count("filters")) {
+        const std::map<std::string, Filter> fl = filterList();
+        std::string s = vm["filters"].as<std::string>();
+        std::stringstream ss(s);
+        std::string name;
+        while(std::getline(ss, name, ',')) {
+            if(name == "all") {
+                for(const auto& kv : fl) {
+                    tgOptions.filters.push_back(kv.second);
+                }
+                continue;
+            }
+            auto it = fl.find(name);
+            if(it == fl.end()) {
+                cout << "Error: unknown filter '" << name << "'" << endl;
+                return 1;
+            }
+            tgOptions.filters.push_back(it->second);
+        }
+        std::sort(tgOptions.filters.begin(), tgOptions.filters.end());
+        tgOptions.filters.erase(std::unique(tgOptions.filters.begin(), tgOptions.filters.end()),
+                                tgOptions.filters.end());
+    }
+    if (vm.count("select")) {
+        const std::string spec = vm["select"].as<std::string>();
+        if(!objectiveFromString(spec, tgOptions.objective)) {
+            cout << "Error: unknown selection objective '" << spec << "'" << endl;
+            return 1;
+        }
+        tgOptions.select = true;
+    }
+    if (vm.count("selectSample")) {
+        tgOptions.selectSample = vm["selectSample"].as<double>();
+    }
+    if (vm.count("results")) {
+        tgOptions.resultFile = vm["results"].as<std::string>();
+    }
+    if (vm.count("csv")) {
+        tgOptions.csvFile = vm["csv"].as<std::string>();
+    }
+    if (vm.count("dedup")) {
+        tgOptions.dedup = true;
+    }
+    if (vm.count("cache")) {
+        tgOptions.cacheFile = vm["cache"].as<std::string>();
+    }
+    if (vm.count("checkpoint")) {
+        tgOptions.checkpointSeconds = std::max(0.0, vm["checkpoint"].as<double>());
+    }
+    if (vm.count("store")) {
+        storeOptions.file = vm["store"].as<std::string>();
+    }
+    if (vm.count("storeL")) {
+        storeOptions.blockSize = std::max(1, vm["storeL"].as<int>());
     }
-    if (geomFile.empty() && segFile.empty() && tgFile.empty() && cwxFile.empty()) {
+    if (vm.count("storeCodec")) {
+        const std::string name = vm["storeCodec"].as<std::string>();
+        if(!codecFromString(name, storeOptions.codec)) {
+            cout << "Error: unknown codec '" << name << "'" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("accesses")) {
+        storeOptions.accesses = std::max(1, vm["accesses"].as<int>());
+    }
+    if (vm.count("cacheMB")) {
+        const std::string spec = vm["cacheMB"].as<std::string>();
+        std::vector<int> mbs;
+        if(!intsFromString(spec, 0, mbs)) {
+            cout << "Error: invalid --cacheMB '" << spec << "', expected comma separated sizes >= 0" << endl;
+            return 1;
+        }
+        storeOptions.cacheBudgets.clear();
+        for(int mb : mbs) {
+            storeOptions.cacheBudgets.push_back(size_t(mb) << 20);
+        }
+    }
+    if (vm.count("fastGeom")) {
+        geomOptions.fast = true;
+    }
+    if (vm.count("countKernel")) {
+        const std::map<std::string, CountKernel> kl = countKernelList();
+        const std::string name = vm["countKernel"].as<std::string>();
+        auto it = kl.find(name);
+        if(it == kl.end()) {
+            cout << "Error: unknown count kernel '" << name << "'" << endl;
+            return 1;
+        }
+        svOptions.kernel = it->second;
+    }
+    if (vm.count("validateCounts")) {
+        svOptions.validate = true;
+    }
+    if (vm.count("countBenchmark")) {
+        svOptions.benchmark = true;
+    }
+    if (vm.count("tuneCodec")) {
+        const std::string name = vm["tuneCodec"].as<std::string>();
+        if(!codecFromString(name, tunerOptions.codec)) {
+            cout << "Error: unknown codec '" << name << "'" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("tuneHalos")) {
+        const std::string spec = vm["tuneHalos"].as<std::string>();
+        if(!intsFromString(spec, 0, tunerOptions.halos)) {
+            cout << "Error: invalid --tuneHalos '" << spec << "', expected comma separated widths >= 0" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("haloCodec")) {
+        const std::string name = vm["haloCodec"].as<std::string>();
+        if(!codecFromString(name, haloOptions.codec)) {
+            cout << "Error: unknown codec '" << name << "'" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("haloL")) {
+        const std::string spec = vm["haloL"].as<std::string>();
+        if(!intsFromString(spec, 1, haloOptions.ls)) {
+            cout << "Error: invalid --haloL '" << spec << "', expected comma separated lengths >= 1" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("haloWidths")) {
+        const std::string spec = vm["haloWidths"].as<std::string>();
+        if(!intsFromString(spec, 1, haloOptions.halos)) {
+            cout << "Error: invalid --haloWidths '" << spec << "', expected comma separated widths >= 1" << endl;
+            return 1;
+        }
+    }
+    storeOptions.nthreads = tgOptions.nthreads;
+    if (vm.count("chromeTrace") || vm.count("traceSummary")) {
+        trace::setThreadName("main");
+        trace::enable();
+    }
+    if (vm.count("merge")) {
+        std::vector<std::string> inputs;
+        std::stringstream ss(vm["merge"].as<std::string>());
+        std::string f;
+        while(std::getline(ss, f, ',')) {
+            inputs.push_back(f);
+        }
+        mergeResults(inputs, tgOptions.resultFile, tgOptions.csvFile);
+        return 0;
+    }
+    if (vm.count("convert")) {
+        if(tgFile.empty()) {
+            cout << "Error: --convert needs --tg" << endl;
+            return 1;
+        }
+        const int l = vm.count("convertChunks") ? std::max(0, vm["convertChunks"].as<int>()) : 0;
+        const std::string codec = vm.count("convertCodec") ? vm["convertCodec"].as<std::string>() : "RAW";
+        const std::string dir = vm["convert"].as<std::string>();
+        cout << "converting " << tgFile << " to " << dir << " (chunks " << l << ", codec " << codec << ")" << endl;
+        convertTg(tgFile, dir, Volume::Shape(l, l, l), codec, tgOptions.nthreads, tgOptions.memoryBudget);
+        return 0;
+    }
+    if (geomFile.empty() && segFile.empty() && tgFile.empty() && cwxFile.empty() && arrayFile.empty() && storeOptions.file.empty()) {
         cout << "Error: Need at least one of --geom and --seg options!" << endl << endl;
         cout << desc << endl;
         return 1;
@@ -72,205 +443,83 @@ int main(int argc, char** argv) {
     
     
     if(!segFile.empty()) {
-        std::cout << "* Loading segmentation from " << segFile << "/" << segGroup << std::endl;
-        HDF5File f(segFile, HDF5File::OpenReadOnly);
-        MultiArray<3, uint32_t> seg;
-        f.readAndResize(segGroup, seg);
-        f.close();
-        supervoxelStatistics(seg);
+        svOptions.nthreads = tgOptions.nthreads;
+        svOptions.memoryBudget = tgOptions.memoryBudget;
+        supervoxelStatistics(segFile, segGroup, svOptions);
     }
     
     if(!geomFile.empty()) {
-        gStatistics(geomFile);
+        geomOptions.nthreads = tgOptions.nthreads;
+        gStatistics(geomFile, geomOptions);
     }
     
-    if(!tgFile.empty()) {
-        
-        std::map<vigra::CompressionMethod, std::ofstream> files;
-        
-        std::map<std::string, vigra::CompressionMethod> cl = compressorList();
-        for(const auto& kv : cl) {
-            files[kv.second].open("stat_"+toString(kv.second)+".txt", std::ios::trunc);
-            files[kv.second] /* 0 */ << "sizeBytesUncompressed "
-                             /* 1 */ << "sizeBytesUncompressed "
-                             /* 2 */ << "timeCompress "
-                             /* 3 */ << "timeUncompress "
-                             /* 4 */ << "msPerMB_compress "
-                             /* 5 */ << "msPerMB_uncompress "
-                             /* 6 */ << "compessionRatio"
-                                     << endl;
+    if(!storeOptions.file.empty()) {
+        if(vm.count("replay")) {
+            replayStatistics(vm["replay"].as<std::string>(), storeOptions);
         }
-        
-        HDF5File f(tgFile, HDF5File::OpenReadOnly);
-        f.cd("blocks");
-        auto ls = f.ls();
-        std::sort(ls.begin(), ls.end());
-        cout << " (" << ls.size() << " blocks) " << endl;
-        int n = 0;
-        for(const auto& x : ls) {
-            if(n >= maxTgBlocks) { break; }
-            
-            MultiArray<3, uint32_t> tg;
-            f.cd(x);
-            f.readAndResize("topological-grid", tg);
-            f.cd_up();
-           
-            BW::Roi<3> roi({0,0,0}, tg.shape());
-            
-            std::vector<int> L = {32, 64, 92, 128, 160, 192, 256};
-            for(int l : L) {
-                BW::Blocking<3> blocking(roi, {l,l,l});
-                auto blocks = blocking.blocks(); 
-                int i=0;
-                for(const auto& x : blocks) {
-                    cout << "\rcompressing " << blocks.size() << " blocks with L=" << l << " "
-                         << "[" << i << "/" << blocks.size() << "]" << flush;
-                    
-                    const BW::Roi<3>& blockRoi = x.second;
-                    MultiArray<3, uint32_t> a = tg.subarray(blockRoi.p, blockRoi.q);
-                    //cout << "compressing block=" << blockRoi.p << " ... " << blockRoi.q << endl;
-                    auto stats = statCompressors(a, false); 
-                    for(const auto& kv : stats) {
-                        vigra::CompressionMethod cflag = kv.first;
-                        const CompressionStatistics& stat = kv.second;
-                        files[cflag] /* 0 */ << stat.sizeBytesUncompressed << " "
-                                     /* 1 */ << stat.sizeBytesUncompressed << " "
-                                     /* 2 */ << stat.timeCompress << " "
-                                     /* 3 */ << stat.timeUncompress << " "
-                                     /* 4 */ << stat.msPerMB_compress() << " "
-                                     /* 5 */ << stat.msPerMB_uncompress() << " "
-                                     /* 6 */ << stat.compessionRatio()
-                                             << endl;
-                    }
-                    ++i;
-                }
-                cout << endl;
-            }
+        else if(vm.count("roiQuery") && !tgFile.empty()) {
+            roiQueryStatistics(tgFile, storeOptions);
         }
-        
-#if 0
-        std::map<std::string, CompressionStatistics> stats;
-        
-        std::map<std::string, CompressionMethod> cm = compressorList();
-        
-        int nthreads = std::thread::hardware_concurrency();
-        cout << "nthreads = " << nthreads << endl;
-        
-        USETICTOC;
-        
-        MultiArray<3, uint32_t> tg;
-
-        //go over all compression methods available
-        for(const auto& kv : cm) {
-            const auto cname = kv.first;
-            const auto cflag = kv.second;
-            cout << "compressing with " << cname << flush;
-            
-            ArrayVector<char> dest;
-            CompressionStatistics stat;
-        
-            HDF5File f(tgFile, HDF5File::OpenReadOnly);
-            f.cd("blocks");
-            auto ls = f.ls();
-            std::sort(ls.begin(), ls.end());
-            cout << " (" << ls.size() << " blocks) " << flush;
-            int n = 0;
-            for(const auto& x : ls) {
-                if(n >= maxTgBlocks) { break; }
-                
-                cout << "c" << flush;
-                f.cd(x);
-                f.readAndResize("topological-grid", tg);
-                stat.totSize += tg.size()*sizeof(uint32_t);
-                
-                TIC;
-                compress(reinterpret_cast<const char*>(tg.data()), tg.size()*sizeof(uint32_t),
-                         dest, cflag, sizeof(uint32_t), nthreads);
-                stat.avgTimeCompress += TOCN;
-                stat.avgCompression += dest.size();
-                
-                cout << "u" << flush;
-                
-                TIC; 
-                uncompress(dest.data(), dest.size(),
-                           reinterpret_cast<char *>(tg.data()), tg.size()*sizeof(uint32_t),
-                           cflag, nthreads);
-                stat.avgTimeUncompress += TOCN;
-                
-                f.cd_up();
-                ++n;
+        else {
+            if(!tgFile.empty()) {
+                writeBlockStore(tgFile, storeOptions);
             }
-            stat.avgTimeCompress   /= ((double)n);
-            stat.avgTimeUncompress /= ((double)n);
-            stat.avgCompression /= stat.totSize;
-            cout << endl;
-            cout << "  compress   " << stat.avgTimeCompress << " ms/block" << endl;
-            cout << "  uncompress " << stat.avgTimeUncompress << " ms/block" << endl;
-            cout << "  ratio      " << stat.avgCompression << endl;
-            
-            
-            stats[cname] = stat;
+            storeStatistics(storeOptions);
         }
-       
-        std::cout << "# method | compress | uncompress | ratio" << std::endl;
-        for(const auto& kv : stats) {
-            const CompressionStatistics& stat = kv.second;
-            std::cout << kv.first
-                      << " | " << setw(10) << stat.avgTimeCompress
-                      << " | " << setw(10) << stat.avgTimeUncompress
-                      << " | " << setw(10) << stat.avgCompression
-                      << std::endl;
+    }
+    else if(!tgFile.empty() && vm.count("tune")) {
+        tunerOptions.nthreads = tgOptions.nthreads;
+        tunerOptions.codecThreads = tgOptions.codecThreads;
+        tunerOptions.timing = tgOptions.timing;
+        tunerStatistics(tgFile, tunerOptions);
+    }
+    else if(!tgFile.empty() && vm.count("halo")) {
+        haloOptions.nthreads = tgOptions.nthreads;
+        haloOptions.codecThreads = tgOptions.codecThreads;
+        haloOptions.timing = tgOptions.timing;
+        haloStatistics(tgFile, haloOptions);
+    }
+    else if(!tgFile.empty() && processes > 1) {
+        std::vector<std::string> args(argv+1, argv+argc);
+        // the processes must not share the cores the parent computed for one
+        if(!vm.count("threads")) {
+            args.push_back("--threads");
+            args.push_back(std::to_string(tgOptions.nthreads));
+        }
+        if(!vm.count("codecThreads")) {
+            args.push_back("--codecThreads");
+            args.push_back(std::to_string(tgOptions.codecThreads));
         }
-        
+        mergeResults(runShards(args, processes, tgOptions.resultFile),
+                     tgOptions.resultFile, tgOptions.csvFile);
+    }
+    else if(!tgFile.empty()) {
+        tgStatistics(tgFile, tgOptions);
     }
     
     if(!cwxFile.empty()) {
-        std::map<std::string, CompressionMethod> cm = compressorList();
-        
-        cout << "nthreads = " << nthreads << endl;
-        
-        USETICTOC;
-        
-        MultiArray<3, uint32_t> tg;
-
-        for(const auto& kv : cm) {
-            const auto cname = kv.first;
-            const auto cflag = kv.second;
-            cout << "compressing with " << cname << flush;
-            
-            ArrayVector<char> dest;
-            double avgTimeCompress   = 0.0;
-            double avgTimeUncompress = 0.0;
-            double totSize = 0.0;
-            double avgCompression = 0.0;
-        
-            HDF5File f(cwxFile, HDF5File::OpenReadOnly);
-            cout << "c" << flush;
-            f.readAndResize("cwx", tg);
-            totSize += tg.size()*sizeof(uint32_t);
-            
-            TIC;
-            compress(reinterpret_cast<const char*>(tg.data()), tg.size()*sizeof(uint32_t),
-                        dest, cflag, sizeof(uint32_t), nthreads);
-            avgTimeCompress += TOCN;
-            avgCompression += dest.size();
-            
-            cout << "u" << flush;
-            
-            TIC; 
-            uncompress(dest.data(), dest.size(),
-                        reinterpret_cast<char *>(tg.data()), tg.size()*sizeof(uint32_t),
-                        cflag, nthreads);
-            avgTimeUncompress += TOCN;
-            
-            f.cd_up();
-            
-            avgCompression /= totSize;
-            cout << endl;
-            cout << "  compress   " << avgTimeCompress << " ms/block" << endl;
-            cout << "  uncompress " << avgTimeUncompress << " ms/block" << endl;
-            cout << "  ratio      " << avgCompression << endl;
+        CwxOptions cwxOptions;
+        cwxOptions.chunkSize = cwxChunkSize;
+        cwxOptions.nthreads = tgOptions.nthreads;
+        cwxOptions.codecThreads = tgOptions.codecThreads;
+        cwxOptions.memoryBudget = tgOptions.memoryBudget;
+        cwxOptions.filters = tgOptions.filters;
+        cwxStatistics(cwxFile, cwxOptions);
+    }
+    
+    if(!arrayFile.empty()) {
+        arrayOptions.nthreads = tgOptions.nthreads;
+        arrayOptions.codecThreads = tgOptions.codecThreads;
+        arrayOptions.timing = tgOptions.timing;
+        arrayOptions.filters = tgOptions.filters;
+        arrayStatistics(arrayFile, arrayDataset, arrayOptions);
+    }
+    
+    if(trace::enabled()) {
+        trace::printSummary();
+        if(vm.count("chromeTrace")) {
+            trace::writeChromeTrace(vm["chromeTrace"].as<std::string>());
+            cout << "trace written to " << vm["chromeTrace"].as<std::string>() << endl;
         }
-#endif
     }
 }
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "codecselector.hxx"
+
+namespace {
+    /**
+     * whether 'a' meets the constraint of 'o'
+     */
+    bool feasible(const SelectionObjective& o, const CompressionStatistics& a) {
+        if(o.kind == SelectionObjective::MAX_RATIO) {
+            return uncompressMBs(a) >= o.minUncompressMBs;
+        }
+        return a.compessionRatio() <= o.maxSizeFraction;
+    }
+
+    /**
+     * whether 'a' is preferable to 'b' under 'o'
+     */
+    bool better(const SelectionObjective& o, const CompressionStatistics& a,
+                const CompressionStatistics& b) {
+        const bool fa = feasible(o, a);
+        const bool fb = feasible(o, b);
+        if(fa != fb) {
+            return fa;
+        }
+        // among feasible candidates optimize the objective, among the
+        // others get as close to the constraint as possible
+        const bool bySize = (o.kind == SelectionObjective::MAX_RATIO) == fa;
+        if(bySize) {
+            return a.compessionRatio() < b.compessionRatio();
+        }
+        return uncompressMBs(a) > uncompressMBs(b);
+    }
+} /* anonymous namespace */
+
+size_t SelectionObjective::best(const std::vector<CompressionStatistics>& candidates) const {
+    size_t b = 0;
+    for(size_t i=1; i<candidates.size(); ++i) {
+        if(better(*this, candidates[i], candidates[b])) {
+            b = i;
+        }
+    }
+    return b;
+}
+
+std::string toString(const SelectionObjective& o) {
+    std::stringstream s;
+    if(o.kind == SelectionObjective::MAX_RATIO) {
+        s << "max ratio with >= " << o.minUncompressMBs << " MB/s decompression";
+    }
+    else {
+        s << "max decompression speed with <= " << o.maxSizeFraction << " of the size";
+    }
+    return s.str();
+}
+
+bool objectiveFromString(const std::string& spec, SelectionObjective& o) {
+    const size_t colon = spec.find(':');
+    if(colon == std::string::npos) {
+        return false;
+    }
+    const std::string kind = spec.substr(0, colon);
+    double value = 0.0;
+    std::stringstream s(spec.substr(colon+1));
+    if(!(s >> value)) {
+        return false;
+    }
+    if(kind == "ratio") {
+        o.kind = SelectionObjective::MAX_RATIO;
+        o.minUncompressMBs = value;
+        return true;
+    }
+    if(kind == "speed") {
+        o.kind = SelectionObjective::MAX_SPEED;
+        o.maxSizeFraction = value;
+        return true;
+    }
+    return false;
+}
+
+double uncompressMBs(const CompressionStatistics& s) {
+    // too fast to measure is the fastest, not the slowest
+    if(s.timeUncompress <= 0.0 && s.sizeBytesUncompressed > 0) {
+        return 1e12;
+    }
+    return MBPerS(s.sizeBytesUncompressed, s.timeUncompress);
+}
+
+CodecSelector::CodecSelector(
+    const std::vector<Codec>& codecs,
+    const SelectionObjective& objective,
+    double sampleFraction,
+    int nthreads
+)
+    : codecs_(codecs)
+    , objective_(objective)
+    , sampleFraction_(std::min(1.0, std::max(0.0, sampleFraction)))
+    , nthreads_(nthreads)
+{
+    if(codecs_.empty()) {
+        throw std::runtime_error("CodecSelector: no codecs to choose from");
+    }
+}
+
+size_t CodecSelector::select(const vigra::MultiArrayView<3, uint32_t>& block,
+                             CodecBuffers& buffers) const {
+    using namespace vigra;
+    if(!block.isUnstrided()) {
+        throw std::runtime_error("CodecSelector: block must be unstrided");
+    }
+    // consecutive z-slices of a contiguous block are contiguous as well
+    const MultiArrayIndex nz = block.shape(2);
+    const MultiArrayIndex k = std::max<MultiArrayIndex>(
+        1, static_cast<MultiArrayIndex>(nz*sampleFraction_ + 0.5));
+    const MultiArrayIndex z0 = (nz-k)/2;
+    const MultiArrayView<3, uint32_t> sample(
+        MultiArrayShape<3>::type(block.shape(0), block.shape(1), k),
+        block.data() + z0*block.shape(0)*block.shape(1));
+
+    std::vector<CompressionStatistics> stats;
+    stats.reserve(codecs_.size());
+    for(const Codec& c : codecs_) {
+        stats.push_back(statCompressor(sample, c, nthreads_, TimingOptions(), buffers));
+    }
+    return objective_.best(stats);
+}
+
+SelectionReport::SelectionReport(size_t numCodecs)
+    : blocks_(0)
+    , uncompressed_(0)
+    , selectMs_(0)
+    , single_(numCodecs)
+    , picks_(numCodecs, 0)
+{}
+
+void SelectionReport::add(const std::vector<CompressionStatistics>& results,
+                          size_t selected, double selectMs) {
+    if(results.size() != single_.size() || selected >= results.size()) {
+        throw std::runtime_error("SelectionReport: wrong number of codecs");
+    }
+    ++blocks_;
+    uncompressed_ += results[selected].sizeBytesUncompressed;
+    selectMs_ += selectMs;
+    for(size_t c=0; c<results.size(); ++c) {
+        single_[c].compressed += results[c].sizeBytesCompressed;
+        single_[c].uncompressMs += results[c].timeUncompress;
+    }
+    mixed_.compressed += results[selected].sizeBytesCompressed;
+    mixed_.uncompressMs += results[selected].timeUncompress;
+    ++picks_[selected];
+}
+
+CompressionStatistics SelectionReport::statistics(const Totals& t) const {
+    CompressionStatistics s;
+    s.sizeBytesUncompressed = uncompressed_;
+    s.sizeBytesCompressed = t.compressed;
+    s.timeUncompress = t.uncompressMs;
+    return s;
+}
+
+void SelectionReport::print(const std::string& name, const CodecSelector& selector) const {
+    using std::cout; using std::endl; using std::setw;
+    if(blocks_ == 0) {
+        return;
+    }
+    const std::vector<Codec>& codecs = selector.codecs();
+
+    std::vector<CompressionStatistics> single;
+    for(const Totals& t : single_) {
+        single.push_back(statistics(t));
+    }
+    const size_t bestSingle = selector.objective().best(single);
+    const CompressionStatistics mixed = statistics(mixed_);
+
+    cout << name << ": " << blocks_ << " blocks, " << toString(selector.objective()) << endl;
+    cout << "  " << setw(24) << "per-block selection" << ": ratio " << mixed.compessionRatio()
+         << ", " << uncompressMBs(mixed) << " MB/s decompression, "
+         << selectMs_/blocks_ << " ms per selection" << endl;
+    cout << "  " << setw(24) << toString(codecs[bestSingle]) << ": ratio "
+         << single[bestSingle].compessionRatio() << ", " << uncompressMBs(single[bestSingle])
+         << " MB/s decompression (best single codec)" << endl;
+    for(size_t c=0; c<codecs.size(); ++c) {
+        if(picks_[c] > 0) {
+            cout << "    picked " << setw(24) << toString(codecs[c]) << " for "
+                 << picks_[c] << " blocks" << endl;
+        }
+    }
+}
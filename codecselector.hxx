@@ -0,0 +1,120 @@
+#ifndef CODECSELECTOR_HXX
+#define CODECSELECTOR_HXX
+
+#include <string>
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "buffers.hxx"
+#include "compressors.hxx"
+
+/**
+ * what a per-block codec choice optimizes
+ */
+struct SelectionObjective {
+    enum Kind {
+        /** smallest compressed size with at least 'minUncompressMBs' decompression speed */
+        MAX_RATIO,
+        /** fastest decompression with at most 'maxSizeFraction' of the input size */
+        MAX_SPEED
+    };
+
+    SelectionObjective()
+      : kind(MAX_RATIO)
+      , minUncompressMBs(0.0)
+      , maxSizeFraction(1.0)
+      {}
+
+    Kind kind;
+    /** constraint of MAX_RATIO, in MB/s */
+    double minUncompressMBs;
+    /** constraint of MAX_SPEED, compressed / uncompressed size */
+    double maxSizeFraction;
+
+    /**
+     * index of the best of 'candidates' (measured on the same data); if
+     * none meets the constraint, the one closest to meeting it
+     */
+    size_t best(const std::vector<CompressionStatistics>& candidates) const;
+};
+
+std::string toString(const SelectionObjective& o);
+
+/**
+ * parse "ratio:<min decompression MB/s>" or "speed:<max compressed fraction>"
+ *
+ * returns: false if 'spec' is neither
+ */
+bool objectiveFromString(const std::string& spec, SelectionObjective& o);
+
+/**
+ * decompression speed in MB/s of a measurement
+ */
+double uncompressMBs(const CompressionStatistics& s);
+
+/**
+ * Picks a codec per block by compressing a sample of the block (a slab of
+ * z-slices from its middle) with every candidate once and applying the
+ * objective to the sample's sizes and decompression times.
+ */
+class CodecSelector {
+    public:
+    CodecSelector(const std::vector<Codec>& codecs,
+                  const SelectionObjective& objective,
+                  double sampleFraction = 0.125,
+                  int nthreads = 1);
+
+    /**
+     * index into the codecs of the one chosen for the (contiguous) 'block'
+     */
+    size_t select(const vigra::MultiArrayView<3, uint32_t>& block, CodecBuffers& buffers) const;
+
+    const std::vector<Codec>& codecs() const { return codecs_; }
+    const SelectionObjective& objective() const { return objective_; }
+
+    private:
+    std::vector<Codec> codecs_;
+    SelectionObjective objective_;
+    double sampleFraction_;
+    int nthreads_;
+};
+
+/**
+ * Compares the codecs picked per block with the best single codec, given
+ * the full measurements of every codec on every block.
+ */
+class SelectionReport {
+    public:
+    explicit SelectionReport(size_t numCodecs = 0);
+
+    /**
+     * 'results' holds the measurements of all codecs on one block, of
+     * which codec 'selected' was picked within 'selectMs' milliseconds
+     */
+    void add(const std::vector<CompressionStatistics>& results, size_t selected, double selectMs);
+
+    /**
+     * print the totals of the selected codecs, of the best single codec
+     * and how often each codec was picked
+     */
+    void print(const std::string& name, const CodecSelector& selector) const;
+
+    private:
+    struct Totals {
+        Totals() : compressed(0), uncompressMs(0) {}
+        double compressed;
+        double uncompressMs;
+    };
+
+    CompressionStatistics statistics(const Totals& t) const;
+
+    size_t blocks_;
+    double uncompressed_;
+    double selectMs_;
+    Totals mixed_;
+    std::vector<Totals> single_;
+    std::vector<size_t> picks_;
+};
+
+#endif /* CODECSELECTOR_HXX */
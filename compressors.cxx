@@ -1,12 +1,14 @@
+#include <cstring>
 #include <map>
+#include <stdexcept>
 #include <thread>
 #include <iomanip>
 
 #include <vigra/compression.hxx>
 #include <vigra/multi_array.hxx>
-#include <vigra/timing.hxx>
 
 #include "compressors.hxx"
+#include "trace.hxx"
 
 std::map<vigra::CompressionMethod, CompressionStatistics> stats;
 
@@ -70,58 +72,301 @@ std::map<std::string, vigra::CompressionMethod> compressorList() {
     return cm;
 }
 
-Stats statCompressors(
-    const vigra::MultiArrayView<3, uint32_t>& a,
-    bool verbose
+std::string toString(const Codec& c) {
+    if(c.filter == NO_FILTER) {
+        return toString(c.method);
+    }
+    return toString(c.filter) + "+" + toString(c.method);
+}
+
+std::vector<Codec> codecList(const std::vector<Filter>& filters) {
+    std::vector<Codec> codecs;
+    std::map<std::string, vigra::CompressionMethod> cl = compressorList();
+    for(Filter f : filters) {
+        for(const auto& kv : cl) {
+            codecs.push_back(Codec(f, kv.second));
+        }
+    }
+    return codecs;
+}
+
+bool codecFromString(const std::string& name, Codec& codec) {
+    std::vector<Filter> filters(1, NO_FILTER);
+    for(const auto& kv : filterList()) {
+        filters.push_back(kv.second);
+    }
+    for(const Codec& c : codecList(filters)) {
+        if(toString(c) == name) {
+            codec = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+template<unsigned int N, class T>
+void checkFilter(Filter f) {
+    if(!supportsFilter<N, T>(f)) {
+        throw std::runtime_error("compressors: filter " + toString(f) + " needs 3-D uint32 blocks");
+    }
+}
+
+// the filters only exist for 3-D uint32 blocks; checkFilter() keeps the
+// generic versions from being reached
+template<unsigned int N, class T>
+size_t filterBlock(Filter, const vigra::MultiArrayView<N, T>&, char*) {
+    return 0;
+}
+
+size_t filterBlock(Filter f, const vigra::MultiArrayView<3, uint32_t>& a, char* dest) {
+    return applyFilter(f, a, dest);
+}
+
+template<unsigned int N, class T>
+void unfilterBlock(Filter, const char*, size_t, const typename vigra::MultiArrayShape<N>::type&, T*) {
+}
+
+template<>
+void unfilterBlock<3, uint32_t>(Filter f, const char* src, size_t size,
+                                const vigra::MultiArrayShape<3>::type& shape, uint32_t* dest) {
+    invertFilter(f, src, size, shape, dest);
+}
+
+} /* anonymous namespace */
+
+template<unsigned int N, class T>
+CompressionStatistics statCompressor(
+    const vigra::MultiArrayView<N, T>& a,
+    const Codec& codec,
+    int nthreads,
+    const TimingOptions& timing
+) {
+    CodecBuffers buffers;
+    return statCompressor(a, codec, nthreads, timing, buffers);
+}
+
+template<unsigned int N, class T>
+CompressionStatistics statCompressor(
+    const vigra::MultiArrayView<N, T>& a,
+    const Codec& codec,
+    int nthreads,
+    const TimingOptions& timing,
+    CodecBuffers& buffers
 ) {
-    using std::cout; using std::endl; using std::flush; using std::setw;
     using namespace vigra;
-    USETICTOC;
     
-    std::map<std::string, CompressionMethod> cm = compressorList();
-    int nthreads = std::thread::hardware_concurrency();
+    checkFilter<N, T>(codec.filter);
+    const size_t size = a.size()*sizeof(T);
+    const bool filtered = codec.filter != NO_FILTER;
+    buffers.reserve(size, filtered ? filteredSize(codec.filter, a.size()) : 0);
+    ArrayVector<char>& dest = buffers.compressed;
     
-    Stats stats; 
+    // the codec sees either the block itself or its filtered version
+    const char* input = reinterpret_cast<const char*>(a.data());
+    size_t inputSize = size;
+    const int typesize = filtered ? filteredTypesize(codec.filter) : sizeof(T);
     
-    for(const auto& kv : cm) {
-        const auto cname = kv.first;
-        const auto cflag = kv.second;
-        if(verbose) {
-            cout << "compressing with " << cname << flush;
+    CompressionStatistics stat(codec);
+    stat.sizeBytesUncompressed = size;
+    
+    std::vector<double>& timesCompress = buffers.timesCompress;
+    std::vector<double>& timesUncompress = buffers.timesUncompress;
+    std::vector<double>& timesFilter = buffers.timesFilter;
+    std::vector<double>& timesUnfilter = buffers.timesUnfilter;
+    timesCompress.clear();
+    timesUncompress.clear();
+    timesFilter.clear();
+    timesUnfilter.clear();
+    double total = 0.0;
+    
+    for(int run=0; ; ++run) {
+        const bool timed = run >= timing.warmup;
+        if(timed && (int)timesCompress.size() >= timing.repetitions && total >= timing.minTimeMs) {
+            break;
         }
         
-        ArrayVector<char> dest;
-    
-        CompressionStatistics stat;
+        if(timing.coldCache) { flushCaches(timing.cacheFlushBytes); }
+        // empty, but keep the capacity
+        dest.erase(dest.begin(), dest.end());
+        Stopwatch t;
+        double tf = 0.0;
+        {
+            TRACE_SPAN("compress");
+            if(filtered) {
+                inputSize = filterBlock(codec.filter, a, buffers.filtered.data());
+                input = buffers.filtered.data();
+                tf = t.elapsedMs();
+            }
+            compress(input, inputSize,
+                        dest, codec.method, typesize, nthreads);
+        }
+        const double tc = t.elapsedMs();
+        
+        if(timing.coldCache) { flushCaches(timing.cacheFlushBytes); }
+        t.restart();
+        double tuf = 0.0;
+        TRACE_SPAN("uncompress");
+        if(filtered) {
+            uncompress(dest.data(), dest.size(),
+                        buffers.filtered.data(), inputSize,
+                        codec.method, nthreads);
+            Stopwatch tInvert;
+            unfilterBlock<N, T>(codec.filter, buffers.filtered.data(), inputSize, a.shape(),
+                                reinterpret_cast<T*>(buffers.roundtrip.data()));
+            tuf = tInvert.elapsedMs();
+        }
+        else {
+            uncompress(dest.data(), dest.size(),
+                        buffers.roundtrip.data(), size,
+                        codec.method, nthreads);
+        }
+        const double tu = t.elapsedMs();
         
-        if(verbose) { 
-            cout << "c" << flush;
+        // verify the inverse once, outside the timed region
+        if(run == 0 && std::memcmp(buffers.roundtrip.data(), a.data(), size) != 0) {
+            throw std::runtime_error("statCompressor: " + toString(codec) + " does not reproduce the block");
         }
-        stat.sizeBytesUncompressed = a.size()*sizeof(uint32_t);
         
-        TIC;
-        compress(reinterpret_cast<const char*>(a.data()), a.size()*sizeof(uint32_t),
-                    dest, cflag, sizeof(uint32_t), nthreads);
-        stat.timeCompress = TOCN;
-        stat.sizeBytesCompressed = dest.size();
+        if(timed) {
+            timesCompress.push_back(tc);
+            timesUncompress.push_back(tu);
+            timesFilter.push_back(tf);
+            timesUnfilter.push_back(tuf);
+            total += tc + tu;
+        }
+    }
+    
+    stat.sizeBytesCompressed = dest.size();
+    trace::add(trace::BYTES_COMPRESSED, dest.size());
+    stat.compressTiming   = summarize(timesCompress);
+    stat.uncompressTiming = summarize(timesUncompress);
+    stat.timeCompress     = stat.compressTiming.median;
+    stat.timeUncompress   = stat.uncompressTiming.median;
+    stat.timeFilter       = summarize(timesFilter).median;
+    stat.timeUnfilter     = summarize(timesUnfilter).median;
+    
+    return stat;
+}
+
+template<unsigned int N, class T>
+size_t encodeBlock(
+    const vigra::MultiArrayView<N, T>& a,
+    const Codec& codec,
+    int nthreads,
+    CodecBuffers& buffers
+) {
+    TRACE_SPAN("compress");
+    checkFilter<N, T>(codec.filter);
+    const size_t size = a.size()*sizeof(T);
+    vigra::ArrayVector<char>& dest = buffers.compressed;
+    dest.erase(dest.begin(), dest.end());
+    if(codec.filter == NO_FILTER) {
+        buffers.reserve(size);
+        vigra::compress(reinterpret_cast<const char*>(a.data()), size,
+                        dest, codec.method, sizeof(T), nthreads);
+        trace::add(trace::BYTES_COMPRESSED, dest.size());
+        return size;
+    }
+    buffers.reserve(size, filteredSize(codec.filter, a.size()));
+    const size_t filtered = filterBlock(codec.filter, a, buffers.filtered.data());
+    vigra::compress(buffers.filtered.data(), filtered,
+                    dest, codec.method, filteredTypesize(codec.filter), nthreads);
+    trace::add(trace::BYTES_COMPRESSED, dest.size());
+    return filtered;
+}
+
+template<unsigned int N, class T>
+void decodeBlock(
+    const char* src,
+    size_t size,
+    size_t filteredSize,
+    const Codec& codec,
+    const typename vigra::MultiArrayShape<N>::type& shape,
+    int nthreads,
+    CodecBuffers& buffers,
+    T* dest
+) {
+    TRACE_SPAN("uncompress");
+    checkFilter<N, T>(codec.filter);
+    if(codec.filter == NO_FILTER) {
+        vigra::uncompress(src, size, reinterpret_cast<char*>(dest), filteredSize,
+                          codec.method, nthreads);
+        return;
+    }
+    if(buffers.filtered.size() < filteredSize) {
+        buffers.filtered.resize(filteredSize);
+        ++buffers.growths;
+    }
+    vigra::uncompress(src, size, buffers.filtered.data(), filteredSize,
+                      codec.method, nthreads);
+    unfilterBlock<N, T>(codec.filter, buffers.filtered.data(), filteredSize, shape, dest);
+}
+
+template<unsigned int N, class T>
+Stats statCompressors(
+    const vigra::MultiArrayView<N, T>& a,
+    bool verbose,
+    int nthreads,
+    const TimingOptions& timing,
+    const std::vector<Filter>& filters
+) {
+    using std::cout; using std::endl; using std::flush; using std::setw;
+    using namespace vigra;
+    
+    if(nthreads <= 0) {
+        nthreads = std::thread::hardware_concurrency();
+    }
+    
+    Stats stats; 
+    
+    for(const Codec& codec : codecList<N, T>(filters)) {
         if(verbose) {
-            cout << "u" << flush;
+            cout << "compressing with " << toString(codec) << flush;
         }
         
-        TIC; 
-        uncompress(dest.data(), dest.size(),
-                    reinterpret_cast<char *>(a.data()), a.size()*sizeof(uint32_t),
-                    cflag, nthreads);
-        stat.timeUncompress += TOCN;
+        CompressionStatistics stat = statCompressor(a, codec, nthreads, timing);
+        
         if(verbose) {
+            const TimingSummary& c = stat.compressTiming;
+            const TimingSummary& u = stat.uncompressTiming;
             cout << endl;
             cout << "  compress   " << stat.msPerMB_compress()   << " MB/ms" << endl;
             cout << "  uncompress " << stat.msPerMB_uncompress() << " MB/ms" << endl;
             cout << "  ratio      " << stat.compessionRatio()    << endl;
+            cout << "  MB/ms over " << c.runs << " runs (min / median / p90 / p99 run time)" << endl;
+            cout << "    compress   " << stat.MBPerMs(c.min) << " / " << stat.MBPerMs(c.median) << " / "
+                                      << stat.MBPerMs(c.p90) << " / " << stat.MBPerMs(c.p99) << endl;
+            cout << "    uncompress " << stat.MBPerMs(u.min) << " / " << stat.MBPerMs(u.median) << " / "
+                                      << stat.MBPerMs(u.p90) << " / " << stat.MBPerMs(u.p99) << endl;
         }
         
-        stats[cflag] = stat;
+        stats[codec] = stat;
     }
     
     return stats;
-}
\ No newline at end of file
+}
+
+#define INSTANTIATE_COMPRESSORS(N, T) \
+    template CompressionStatistics statCompressor<N, T>( \
+        const vigra::MultiArrayView<N, T>&, const Codec&, int, const TimingOptions&); \
+    template CompressionStatistics statCompressor<N, T>( \
+        const vigra::MultiArrayView<N, T>&, const Codec&, int, const TimingOptions&, CodecBuffers&); \
+    template size_t encodeBlock<N, T>( \
+        const vigra::MultiArrayView<N, T>&, const Codec&, int, CodecBuffers&); \
+    template void decodeBlock<N, T>( \
+        const char*, size_t, size_t, const Codec&, const vigra::MultiArrayShape<N>::type&, \
+        int, CodecBuffers&, T*); \
+    template Stats statCompressors<N, T>( \
+        const vigra::MultiArrayView<N, T>&, bool, int, const TimingOptions&, const std::vector<Filter>&);
+
+#define INSTANTIATE_COMPRESSORS_FOR_TYPE(T) \
+    INSTANTIATE_COMPRESSORS(2, T) \
+    INSTANTIATE_COMPRESSORS(3, T) \
+    INSTANTIATE_COMPRESSORS(4, T)
+
+INSTANTIATE_COMPRESSORS_FOR_TYPE(uint8_t)
+INSTANTIATE_COMPRESSORS_FOR_TYPE(uint16_t)
+INSTANTIATE_COMPRESSORS_FOR_TYPE(uint32_t)
+INSTANTIATE_COMPRESSORS_FOR_TYPE(uint64_t)
@@ -1,23 +1,66 @@
 #ifndef COMPRESSORS_HXX
 #define COMPRESSORS_HXX
 
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 
 #include <vigra/multi_array.hxx>
+#include <vigra/compression.hxx>
+
+#include "benchmark.hxx"
+#include "buffers.hxx"
+#include "filters.hxx"
+
+/**
+ * a filter followed by a compression method
+ */
+struct Codec {
+    Codec()
+      : filter(NO_FILTER)
+      , method(vigra::NO_COMPRESSION)
+      {}
+
+    Codec(vigra::CompressionMethod m)
+      : filter(NO_FILTER)
+      , method(m)
+      {}
+
+    Codec(Filter f, vigra::CompressionMethod m)
+      : filter(f)
+      , method(m)
+      {}
+
+    bool operator<(const Codec& other) const {
+        return filter < other.filter || (filter == other.filter && method < other.method);
+    }
+    bool operator==(const Codec& other) const {
+        return filter == other.filter && method == other.method;
+    }
+
+    Filter filter;
+    vigra::CompressionMethod method;
+};
 
 struct CompressionStatistics {
-    CompressionStatistics(vigra::CompressionMethod m)
+    CompressionStatistics(const Codec& c)
       : timeCompress(0)
       , timeUncompress(0)
+      , timeFilter(0)
+      , timeUnfilter(0)
       , sizeBytesUncompressed(0)
       , sizeBytesCompressed(0)
-      , compressor(m) {}
+      , compressor(c.method)
+      , filter(c.filter) {}
       
     CompressionStatistics()
       : timeCompress(0)
       , timeUncompress(0)
+      , timeFilter(0)
+      , timeUnfilter(0)
       , sizeBytesUncompressed(0)
       , sizeBytesCompressed(0)
+      , filter(NO_FILTER)
       {}
         
     double compessionRatio() const {
@@ -29,23 +72,155 @@ struct CompressionStatistics {
     double msPerMB_uncompress() const {
         return timeUncompress / (sizeBytesUncompressed/(1024*1024));
     }
+    /**
+     * throughput in MB/ms for a run that took 'ms' milliseconds
+     */
+    double MBPerMs(double ms) const {
+        return (sizeBytesUncompressed/(1024*1024)) / ms;
+    }
         
+    /** median run time in ms */
     double timeCompress;
+    /** median run time in ms */
     double timeUncompress;
+    /** median time in ms of the filter alone (included in timeCompress) */
+    double timeFilter;
+    /** median time in ms of inverting the filter (included in timeUncompress) */
+    double timeUnfilter;
+    TimingSummary compressTiming;
+    TimingSummary uncompressTiming;
     double sizeBytesUncompressed;
     double sizeBytesCompressed;
     vigra::CompressionMethod compressor;
+    Filter filter;
+    
+    Codec codec() const {
+        return Codec(filter, compressor);
+    }
 };
 
 std::map<std::string, vigra::CompressionMethod> compressorList();
 
 std::string toString(const vigra::CompressionMethod m);
 
-typedef std::map<vigra::CompressionMethod, CompressionStatistics> Stats;
+/**
+ * name of the method, prefixed by "<FILTER>+" if there is a filter
+ */
+std::string toString(const Codec& c);
+
+/**
+ * all methods of compressorList(), each after every filter in 'filters'
+ */
+std::vector<Codec> codecList(const std::vector<Filter>& filters);
+
+/**
+ * the codec whose toString() is 'name' (e.g. "LZ4" or "DELTA+LZ4")
+ *
+ * returns: false if there is no such codec
+ */
+bool codecFromString(const std::string& name, Codec& codec);
+
+typedef std::map<Codec, CompressionStatistics> Stats;
+
+/*
+ * The compressor benchmark works on N-dimensional arrays of any unsigned
+ * integer type; it is instantiated for uint8_t, uint16_t, uint32_t and
+ * uint64_t with N = 2, 3 and 4. The filters are only defined for 3-D
+ * uint32_t blocks (topological grids), see supportsFilter().
+ */
+
+/**
+ * whether codecs with filter 'f' can be used for N-dimensional arrays of T
+ */
+template<unsigned int N, class T>
+bool supportsFilter(Filter f) {
+    return f == NO_FILTER || (N == 3 && std::is_same<T, uint32_t>::value);
+}
+
+/**
+ * the codecs of codecList(filters) that support N-dimensional arrays of T
+ */
+template<unsigned int N, class T>
+std::vector<Codec> codecList(const std::vector<Filter>& filters) {
+    std::vector<Codec> codecs;
+    for(const Codec& c : codecList(filters)) {
+        if(supportsFilter<N, T>(c.filter)) {
+            codecs.push_back(c);
+        }
+    }
+    return codecs;
+}
+
+/**
+ * filter, compress, uncompress and unfilter the (contiguous) array 'a' with
+ * a single codec, handing 'nthreads' threads to the compression method,
+ * repeated as given by 'timing'; the codecs get sizeof(T) as type size
+ * hint (or that of the filter's output)
+ *
+ * 'a' is only read, so several codecs may run concurrently on the same array.
+ * Throws if the codec's filter does not support the array (supportsFilter()).
+ */
+template<unsigned int N, class T>
+CompressionStatistics statCompressor(
+    const vigra::MultiArrayView<N, T>& a,
+    const Codec& codec,
+    int nthreads,
+    const TimingOptions& timing = TimingOptions()
+);
+
+/**
+ * as above, but compresses into the caller's 'buffers', which makes the
+ * measurement allocation-free once the buffers have been reserved
+ */
+template<unsigned int N, class T>
+CompressionStatistics statCompressor(
+    const vigra::MultiArrayView<N, T>& a,
+    const Codec& codec,
+    int nthreads,
+    const TimingOptions& timing,
+    CodecBuffers& buffers
+);
+
+/**
+ * filter and compress the (contiguous) array 'a' into buffers.compressed
+ *
+ * returns: the size of the filtered data, which decodeBlock needs
+ */
+template<unsigned int N, class T>
+size_t encodeBlock(
+    const vigra::MultiArrayView<N, T>& a,
+    const Codec& codec,
+    int nthreads,
+    CodecBuffers& buffers
+);
+
+/**
+ * undo encodeBlock: uncompress the 'size' bytes at 'src' and invert the
+ * filter, writing the block of shape 'shape' contiguously to 'dest'
+ */
+template<unsigned int N, class T>
+void decodeBlock(
+    const char* src,
+    size_t size,
+    size_t filteredSize,
+    const Codec& codec,
+    const typename vigra::MultiArrayShape<N>::type& shape,
+    int nthreads,
+    CodecBuffers& buffers,
+    T* dest
+);
 
+/**
+ * run statCompressor for all codecs in codecList<N, T>(filters),
+ * 'nthreads' <= 0 means std::thread::hardware_concurrency()
+ */
+template<unsigned int N, class T>
 Stats statCompressors(
-    const vigra::MultiArrayView<3, uint32_t>& a,
-    bool verbose = true
+    const vigra::MultiArrayView<N, T>& a,
+    bool verbose = true,
+    int nthreads = 0,
+    const TimingOptions& timing = TimingOptions(),
+    const std::vector<Filter>& filters = std::vector<Filter>(1, NO_FILTER)
 );
 
 #endif /* COMPRESSORS_HXX */
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "cwxstatistics.hxx"
+#include "blocking.h"
+#include "buffers.hxx"
+#include "compressors.hxx"
+#include "hdf5volume.hxx"
+#include "pipeline.hxx"
+#include "threadpool.hxx"
+
+namespace {
+
+/**
+ * sizes and wall clock times of one codec, summed over all bricks
+ */
+struct CodecTotals {
+    CodecTotals()
+      : uncompressed(0)
+      , compressed(0)
+      , compressMs(0)
+      , uncompressMs(0)
+      {}
+
+    double uncompressed;
+    double compressed;
+    double compressMs;
+    double uncompressMs;
+};
+
+} /* anonymous namespace */
+
+void cwxStatistics(const std::string& cwxFile, const CwxOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl; using std::flush; using std::setw;
+
+    const int l = std::max(1, options.chunkSize);
+    HDF5Volume volume(cwxFile, "cwx");
+    const HDF5Volume::Shape shape = volume.shape();
+    // the brick being read, the one being compressed, its chunks and the
+    // compressed chunks share the budget
+    const HDF5Volume::Shape brick = brickShape(shape, HDF5Volume::Shape(l, l, l),
+                                               volume.chunkShape(), options.memoryBudget/4);
+    const BW::Blocking<3> bricks(BW::Roi<3>({0,0,0}, shape), brick);
+    const std::vector<Codec> codecs = codecList(options.filters);
+
+    ThreadPool pool(options.nthreads);
+    cout << "* cwx benchmark of " << cwxFile << " " << shape << ": " << bricks.numBlocks()
+         << " bricks of " << brick << ", chunks of " << l << "^3, nthreads = " << pool.size()
+         << ", codec threads = " << options.codecThreads << endl;
+
+    struct Brick {
+        BW::Roi<3> roi;
+        MultiArray<3, uint32_t> buffer;
+    };
+    size_t next = 0;
+    Prefetcher<Brick> reader([&](Brick& b) {
+        if(next >= bricks.numBlocks()) {
+            return false;
+        }
+        b.roi = bricks[next++].second;
+        if(b.buffer.size() < prod(brick)) {
+            b.buffer.reshape(brick);
+        }
+        volume.read(b.roi, MultiArrayView<3, uint32_t>(b.roi.shape(), b.buffer.data()));
+        return true;
+    }, 1);
+
+    std::vector<CodecBuffers> codecBuffers(pool.size());
+    // the chunks of the current brick, one after the other, and their
+    // compressed versions; both keep their memory from brick to brick
+    ArrayVector<uint32_t> chunked(prod(brick));
+    std::vector<ArrayVector<char> > compressed;
+    std::vector<size_t> filteredSizes;
+    std::vector<CodecTotals> totals(codecs.size());
+
+    size_t brickIndex = 0;
+    while(Brick* b = reader.next()) {
+        ++brickIndex;
+        const MultiArrayView<3, uint32_t> data(b->roi.shape(), b->buffer.data());
+        const BW::Roi<3> roi({0,0,0}, b->roi.shape());
+        const BW::Blocking<3> chunks(roi, {l,l,l});
+        const size_t n = chunks.numBlocks();
+
+        std::vector<MultiArrayView<3, uint32_t> > views;
+        size_t offset = 0;
+        for(size_t k=0; k<n; ++k) {
+            const BW::Roi<3> c = chunks[k].second;
+            views.push_back(MultiArrayView<3, uint32_t>(c.shape(), chunked.data() + offset));
+            offset += c.size();
+        }
+        for(size_t k=0; k<n; ++k) {
+            pool.submit([&, k]() {
+                extractBlock<uint32_t>(data, chunks[k].second, views[k].data());
+            });
+        }
+        pool.wait();
+        if(compressed.size() < n) {
+            compressed.resize(n);
+            filteredSizes.resize(n);
+        }
+
+        for(size_t c=0; c<codecs.size(); ++c) {
+            const Codec& codec = codecs[c];
+            cout << "\r  brick " << brickIndex << "/" << bricks.numBlocks() << " "
+                 << setw(32) << toString(codec) << flush;
+
+            Stopwatch t;
+            for(size_t k=0; k<n; ++k) {
+                pool.submit([&, k]() {
+                    CodecBuffers& buffers = codecBuffers[ThreadPool::currentWorker()];
+                    filteredSizes[k] = encodeBlock(views[k], codec, options.codecThreads, buffers);
+                    // keep the result, hand the chunk's previous storage to the buffers
+                    compressed[k].swap(buffers.compressed);
+                });
+            }
+            pool.wait();
+            totals[c].compressMs += t.elapsedMs();
+
+            t.restart();
+            for(size_t k=0; k<n; ++k) {
+                pool.submit([&, k]() {
+                    CodecBuffers& buffers = codecBuffers[ThreadPool::currentWorker()];
+                    buffers.reserve(views[k].size()*sizeof(uint32_t));
+                    decodeBlock<3, uint32_t>(compressed[k].data(), compressed[k].size(), filteredSizes[k],
+                                             codec, views[k].shape(), options.codecThreads, buffers,
+                                             reinterpret_cast<uint32_t*>(buffers.roundtrip.data()));
+                });
+            }
+            pool.wait();
+            totals[c].uncompressMs += t.elapsedMs();
+
+            for(size_t k=0; k<n; ++k) {
+                totals[c].compressed += compressed[k].size();
+            }
+            totals[c].uncompressed += data.size()*sizeof(uint32_t);
+        }
+    }
+    cout << endl << "  " << reader.waitMs()/1000.0 << " s waiting for reads" << endl;
+
+    std::ofstream file("cwx.txt", std::ios::trunc);
+    file /* 0 */ << "codec "
+         /* 1 */ << "sizeBytesUncompressed "
+         /* 2 */ << "sizeBytesCompressed "
+         /* 3 */ << "compessionRatio "
+         /* 4 */ << "timeCompress "
+         /* 5 */ << "timeUncompress "
+         /* 6 */ << "MBPerS_compress "
+         /* 7 */ << "MBPerS_uncompress"
+                 << endl;
+    cout << "# " << setw(30) << "codec" << " | " << setw(10) << "ratio"
+         << " | " << setw(12) << "compress" << " | " << setw(12) << "uncompress" << " (MB/s)" << endl;
+    for(size_t c=0; c<codecs.size(); ++c) {
+        const CodecTotals& t = totals[c];
+        const double ratio = t.uncompressed > 0 ? t.compressed/t.uncompressed : 0.0;
+        cout << "  " << setw(30) << toString(codecs[c]) << " | " << setw(10) << ratio
+             << " | " << setw(12) << MBPerS(t.uncompressed, t.compressMs)
+             << " | " << setw(12) << MBPerS(t.uncompressed, t.uncompressMs) << endl;
+        file /* 0 */ << toString(codecs[c]) << " "
+             /* 1 */ << t.uncompressed << " "
+             /* 2 */ << t.compressed << " "
+             /* 3 */ << ratio << " "
+             /* 4 */ << t.compressMs << " "
+             /* 5 */ << t.uncompressMs << " "
+             /* 6 */ << MBPerS(t.uncompressed, t.compressMs) << " "
+             /* 7 */ << MBPerS(t.uncompressed, t.uncompressMs)
+                     << endl;
+    }
+}
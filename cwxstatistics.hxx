@@ -0,0 +1,43 @@
+#ifndef CWXSTATISTICS_HXX
+#define CWXSTATISTICS_HXX
+
+#include <string>
+#include <vector>
+
+#include "filters.hxx"
+
+struct CwxOptions {
+    CwxOptions()
+      : chunkSize(128)
+      , nthreads(1)
+      , codecThreads(1)
+      , memoryBudget(size_t(1) << 30)
+      , filters(1, NO_FILTER)
+      {}
+
+    /** edge length of the chunks compressed independently */
+    int chunkSize;
+    /** number of threads compressing chunks in parallel */
+    int nthreads;
+    /** number of threads each codec may use internally */
+    int codecThreads;
+    /**
+     * bound on the memory held at once: the brick being read, the brick
+     * being compressed, its chunks and their compressed versions
+     */
+    size_t memoryBudget;
+    /** filters applied before each codec, as for the tg benchmark */
+    std::vector<Filter> filters;
+};
+
+/**
+ * Whole-volume benchmark of the "cwx" dataset in 'cwxFile': the volume is
+ * streamed brick by brick and cut into chunks of options.chunkSize^3
+ * voxels. For every codec of codecList(options.filters), all chunks of a
+ * brick are compressed in parallel, then all of them are decompressed in
+ * parallel. Prints the aggregate ratio and throughput per codec and
+ * writes them to cwx.txt.
+ */
+void cwxStatistics(const std::string& cwxFile, const CwxOptions& options);
+
+#endif /* CWXSTATISTICS_HXX */
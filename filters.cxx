@@ -0,0 +1,331 @@
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "filters.hxx"
+#include "labelpack.hxx"
+
+std::string toString(const Filter f) {
+    switch(f) {
+        case NO_FILTER:
+        return "NO_FILTER";
+        case DELTA_FILTER:
+        return "DELTA";
+        case XOR_ROW_FILTER:
+        return "XOR_ROW";
+        case BITSHUFFLE_FILTER:
+        return "BITSHUFFLE";
+        case LATTICE_FILTER:
+        return "LATTICE";
+        case BITPACK_FILTER:
+        return "BITPACK";
+    }
+    return "";
+}
+
+std::map<std::string, Filter> filterList() {
+    std::map<std::string, Filter> fl;
+    fl["delta"]      = DELTA_FILTER;
+    fl["xor"]        = XOR_ROW_FILTER;
+    fl["bitshuffle"] = BITSHUFFLE_FILTER;
+    fl["lattice"]    = LATTICE_FILTER;
+    fl["bitpack"]    = BITPACK_FILTER;
+    return fl;
+}
+
+size_t filteredSize(Filter f, size_t elements) {
+    if(f == BITPACK_FILTER) {
+        return packedLabelsBound(elements);
+    }
+    return elements*sizeof(uint32_t);
+}
+
+bool isFilteredSize(Filter f, size_t elements, size_t bytes) {
+    if(f == BITPACK_FILTER) {
+        return bytes <= packedLabelsBound(elements);
+    }
+    return bytes == elements*sizeof(uint32_t);
+}
+
+int filteredTypesize(Filter f) {
+    return (f == BITSHUFFLE_FILTER || f == BITPACK_FILTER) ? 1 : sizeof(uint32_t);
+}
+
+namespace {
+
+typedef vigra::MultiArrayShape<3>::type Shape;
+
+//
+// DELTA: rows along axis 0
+//
+
+void deltaEncode(const uint32_t* in, size_t X, size_t rows, uint32_t* out) {
+    for(size_t r=0; r<rows; ++r, in+=X, out+=X) {
+        if(X == 0) { continue; }
+        out[0] = in[0];
+        size_t i = 1;
+#ifdef __SSE2__
+        for(; i+4<=X; i+=4) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+i-1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_sub_epi32(a, b));
+        }
+#endif
+        for(; i<X; ++i) {
+            out[i] = in[i] - in[i-1];
+        }
+    }
+}
+
+void deltaDecode(const uint32_t* in, size_t X, size_t rows, uint32_t* out) {
+    for(size_t r=0; r<rows; ++r, in+=X, out+=X) {
+        if(X == 0) { continue; }
+        out[0] = in[0];
+        size_t i = 1;
+#ifdef __SSE2__
+        // prefix sum within each vector, plus the carry of the previous one
+        __m128i carry = _mm_set1_epi32(out[0]);
+        for(; i+4<=X; i+=4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+i));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), v);
+            carry = _mm_shuffle_epi32(v, 0xFF);
+        }
+#endif
+        for(; i<X; ++i) {
+            out[i] = out[i-1] + in[i];
+        }
+    }
+}
+
+//
+// XOR_ROW: rows along axis 0, XORed with the previous row along axis 1
+//
+
+void xorRows(const uint32_t* a, const uint32_t* b, size_t X, uint32_t* out) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i+4<=X; i+=4) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a+i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b+i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_xor_si128(va, vb));
+    }
+#endif
+    for(; i<X; ++i) {
+        out[i] = a[i] ^ b[i];
+    }
+}
+
+void xorEncode(const uint32_t* in, const Shape& s, uint32_t* out) {
+    const size_t X = s[0];
+    for(vigra::MultiArrayIndex z=0; z<s[2]; ++z) {
+        const uint32_t* plane = in + z*s[0]*s[1];
+        uint32_t* outPlane = out + z*s[0]*s[1];
+        if(s[1] > 0) {
+            std::memcpy(outPlane, plane, X*sizeof(uint32_t));
+        }
+        for(vigra::MultiArrayIndex y=1; y<s[1]; ++y) {
+            xorRows(plane + y*X, plane + (y-1)*X, X, outPlane + y*X);
+        }
+    }
+}
+
+void xorDecode(const uint32_t* in, const Shape& s, uint32_t* out) {
+    const size_t X = s[0];
+    for(vigra::MultiArrayIndex z=0; z<s[2]; ++z) {
+        const uint32_t* plane = in + z*s[0]*s[1];
+        uint32_t* outPlane = out + z*s[0]*s[1];
+        if(s[1] > 0) {
+            std::memcpy(outPlane, plane, X*sizeof(uint32_t));
+        }
+        for(vigra::MultiArrayIndex y=1; y<s[1]; ++y) {
+            xorRows(plane + y*X, outPlane + (y-1)*X, X, outPlane + y*X);
+        }
+    }
+}
+
+//
+// BITSHUFFLE: for each group of 8 values and each of their 4 bytes,
+// transpose the 8x8 bit matrix. Output: 32 bit-planes of n/8 bytes,
+// followed by the n%8 trailing values unchanged.
+//
+
+/**
+ * transpose the 8x8 bit matrix whose rows are the bytes of 'x'
+ * (Hacker's Delight, 7-3); the operation is its own inverse
+ */
+inline uint64_t transpose8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7))  & 0x00AA00AA00AA00AAULL; x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL; x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL; x = x ^ t ^ (t << 28);
+    return x;
+}
+
+void bitshuffleEncode(const uint32_t* in, size_t n, unsigned char* out) {
+    const size_t groups = n/8;
+    for(size_t g=0; g<groups; ++g) {
+        const uint32_t* v = in + 8*g;
+        for(int b=0; b<4; ++b) {
+            uint64_t x = 0;
+            for(int k=0; k<8; ++k) {
+                x |= uint64_t((v[k] >> (8*b)) & 0xFF) << (8*k);
+            }
+            x = transpose8(x);
+            for(int j=0; j<8; ++j) {
+                out[(b*8+j)*groups + g] = (x >> (8*j)) & 0xFF;
+            }
+        }
+    }
+    std::memcpy(out + 32*groups, in + 8*groups, (n - 8*groups)*sizeof(uint32_t));
+}
+
+void bitshuffleDecode(const unsigned char* in, size_t n, uint32_t* out) {
+    const size_t groups = n/8;
+    for(size_t g=0; g<groups; ++g) {
+        uint32_t* v = out + 8*g;
+        for(int k=0; k<8; ++k) { v[k] = 0; }
+        for(int b=0; b<4; ++b) {
+            uint64_t x = 0;
+            for(int j=0; j<8; ++j) {
+                x |= uint64_t(in[(b*8+j)*groups + g]) << (8*j);
+            }
+            x = transpose8(x);
+            for(int k=0; k<8; ++k) {
+                v[k] |= uint32_t((x >> (8*k)) & 0xFF) << (8*b);
+            }
+        }
+    }
+    std::memcpy(out + 8*groups, in + 32*groups, (n - 8*groups)*sizeof(uint32_t));
+}
+
+//
+// LATTICE: the 8 parity sub-lattices, ordered by (z%2, y%2, x%2), each
+// stored contiguously with axis 0 fastest
+//
+
+/**
+ * start of each of the 8 sub-lattices in the de-interleaved layout
+ */
+void latticeOffsets(const Shape& s, size_t offsets[8]) {
+    size_t o = 0;
+    for(int pz=0; pz<2; ++pz)
+    for(int py=0; py<2; ++py)
+    for(int px=0; px<2; ++px) {
+        offsets[px + 2*py + 4*pz] = o;
+        o += size_t((s[0]+1-px)/2) * ((s[1]+1-py)/2) * ((s[2]+1-pz)/2);
+    }
+}
+
+void splitRow(const uint32_t* row, size_t X, uint32_t* even, uint32_t* odd) {
+    size_t x = 0;
+#ifdef __SSE2__
+    for(; x+8<=X; x+=8) {
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row+x)));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row+x+4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(even+x/2),
+                         _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(odd+x/2),
+                         _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1))));
+    }
+#endif
+    for(; x<X; ++x) {
+        if(x % 2 == 0) { even[x/2] = row[x]; }
+        else           { odd[x/2]  = row[x]; }
+    }
+}
+
+void mergeRow(const uint32_t* even, const uint32_t* odd, size_t X, uint32_t* row) {
+    size_t x = 0;
+#ifdef __SSE2__
+    for(; x+8<=X; x+=8) {
+        __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(even+x/2));
+        __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(odd+x/2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row+x),   _mm_unpacklo_epi32(e, o));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row+x+4), _mm_unpackhi_epi32(e, o));
+    }
+#endif
+    for(; x<X; ++x) {
+        row[x] = (x % 2 == 0) ? even[x/2] : odd[x/2];
+    }
+}
+
+template<bool Encode>
+void lattice(const Shape& s, const uint32_t* in, uint32_t* out) {
+    size_t offsets[8];
+    latticeOffsets(s, offsets);
+    const size_t X = s[0];
+    const size_t nx[2] = { (X+1)/2, X/2 };
+    const size_t ny[2] = { size_t(s[1]+1)/2, size_t(s[1])/2 };
+    for(vigra::MultiArrayIndex z=0; z<s[2]; ++z) {
+        for(vigra::MultiArrayIndex y=0; y<s[1]; ++y) {
+            const int py = y%2, pz = z%2;
+            // row index inside the sub-lattices (y/2, z/2)
+            const size_t r = y/2 + (z/2)*ny[py];
+            const size_t even = offsets[0 + 2*py + 4*pz] + r*nx[0];
+            const size_t odd  = offsets[1 + 2*py + 4*pz] + r*nx[1];
+            const size_t full = (y + z*s[1])*X;
+            if(Encode) { splitRow(in + full, X, out + even, out + odd); }
+            else       { mergeRow(in + even, in + odd, X, out + full); }
+        }
+    }
+}
+
+} /* anonymous namespace */
+
+size_t applyFilter(Filter f, const vigra::MultiArrayView<3, uint32_t>& src, char* dest) {
+    const Shape s = src.shape();
+    const size_t n = src.size();
+    const uint32_t* in = src.data();
+    uint32_t* out = reinterpret_cast<uint32_t*>(dest);
+    switch(f) {
+        case NO_FILTER:
+        std::memcpy(dest, in, n*sizeof(uint32_t));
+        break;
+        case DELTA_FILTER:
+        deltaEncode(in, s[0], s[0] ? n/s[0] : 0, out);
+        break;
+        case XOR_ROW_FILTER:
+        xorEncode(in, s, out);
+        break;
+        case BITSHUFFLE_FILTER:
+        bitshuffleEncode(in, n, reinterpret_cast<unsigned char*>(dest));
+        break;
+        case LATTICE_FILTER:
+        lattice<true>(s, in, out);
+        break;
+        case BITPACK_FILTER:
+        return serializeLabels(src, dest);
+    }
+    return filteredSize(f, n);
+}
+
+void invertFilter(Filter f, const char* src, size_t size,
+                  const vigra::MultiArrayShape<3>::type& shape, uint32_t* dest) {
+    const size_t n = shape[0]*shape[1]*shape[2];
+    const uint32_t* in = reinterpret_cast<const uint32_t*>(src);
+    switch(f) {
+        case NO_FILTER:
+        std::memcpy(dest, src, size);
+        break;
+        case DELTA_FILTER:
+        deltaDecode(in, shape[0], shape[0] ? n/shape[0] : 0, dest);
+        break;
+        case XOR_ROW_FILTER:
+        xorDecode(in, shape, dest);
+        break;
+        case BITSHUFFLE_FILTER:
+        bitshuffleDecode(reinterpret_cast<const unsigned char*>(src), n, dest);
+        break;
+        case LATTICE_FILTER:
+        lattice<false>(shape, in, dest);
+        break;
+        case BITPACK_FILTER:
+        deserializeLabels(src, size, n, dest);
+        break;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef FILTERS_HXX
+#define FILTERS_HXX
+
+#include <map>
+#include <string>
+
+#include <vigra/multi_array.hxx>
+
+/**
+ * Reversible transforms applied to a block before it is handed to a codec.
+ */
+enum Filter {
+    /** pass the block through unchanged */
+    NO_FILTER,
+    /** difference to the previous voxel along axis 0 */
+    DELTA_FILTER,
+    /** XOR with the previous row along axis 1 */
+    XOR_ROW_FILTER,
+    /** transpose the bits of every 8 values, grouped by byte (bit-planes) */
+    BITSHUFFLE_FILTER,
+    /**
+     * de-interleave the 8 parity sub-lattices (x%2, y%2, z%2); in a
+     * topological grid these hold the 0-, 1-, 2- and 3-cells separately
+     */
+    LATTICE_FILTER,
+    /**
+     * local label dictionary plus bit-packed indices (see labelpack.hxx);
+     * the only filter whose output size depends on the data
+     */
+    BITPACK_FILTER
+};
+
+std::string toString(const Filter f);
+
+/**
+ * all filters (except NO_FILTER) by their lower case name
+ */
+std::map<std::string, Filter> filterList();
+
+/**
+ * maximum number of bytes applyFilter writes for a block of 'elements' values
+ */
+size_t filteredSize(Filter f, size_t elements);
+
+/**
+ * whether applyFilter can write exactly 'bytes' bytes for a block of
+ * 'elements' values (for checking sizes read from files)
+ */
+bool isFilteredSize(Filter f, size_t elements, size_t bytes);
+
+/**
+ * element size to pass to the codecs (as blosc shuffle hint)
+ * for data that went through 'f'
+ */
+int filteredTypesize(Filter f);
+
+/**
+ * apply 'f' to the contiguous block 'src', writing filteredSize() bytes
+ * to 'dest'
+ *
+ * returns: the number of bytes written
+ */
+size_t applyFilter(Filter f, const vigra::MultiArrayView<3, uint32_t>& src, char* dest);
+
+/**
+ * undo applyFilter: 'src' holds the 'size' filtered bytes of a block of
+ * shape 'shape', which is reconstructed contiguously at 'dest'
+ */
+void invertFilter(Filter f, const char* src, size_t size,
+                  const vigra::MultiArrayShape<3>::type& shape, uint32_t* dest);
+
+#endif /* FILTERS_HXX */
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "halostatistics.hxx"
+#include "blocking.h"
+#include "blocksampler.hxx"
+#include "buffers.hxx"
+#include "storestatistics.hxx"
+
+namespace {
+
+typedef vigra::MultiArrayShape<3>::type Shape;
+
+/**
+ * the non-empty parts of 'halo' outside 'core' (which it extends on the
+ * upper side): piece m (1 <= m < 8) lies beyond the core along the axes
+ * whose bit is set in m, so there are up to 3 face slabs, 3 edges and
+ * 1 corner
+ */
+std::vector<std::pair<int, BW::Roi<3> > > shellPieces(const BW::Roi<3>& core,
+                                                      const BW::Roi<3>& halo) {
+    std::vector<std::pair<int, BW::Roi<3> > > pieces;
+    for(int m=1; m<8; ++m) {
+        BW::Roi<3> piece;
+        bool empty = false;
+        for(int d=0; d<3; ++d) {
+            const bool beyond = m & (1 << d);
+            piece.p[d] = beyond ? core.q[d] : core.p[d];
+            piece.q[d] = beyond ? halo.q[d] : core.q[d];
+            empty = empty || piece.q[d] <= piece.p[d];
+        }
+        if(!empty) {
+            pieces.push_back(std::make_pair(m, piece));
+        }
+    }
+    return pieces;
+}
+
+/**
+ * Measures the layouts of one L on sampled blocks, on a thread pool.
+ */
+class HaloMeasurement {
+    public:
+    HaloMeasurement(const vigra::MultiArrayView<3, uint32_t>& data, const HaloOptions& options)
+        : data_(data)
+        , options_(options)
+        , sampler_(data, options.codec, options.nthreads, options.codecThreads, options.timing)
+    {}
+
+    /**
+     * results for every width in 'halos' (all in [1, l]) with core edge
+     * length 'l'
+     */
+    std::vector<HaloResult> run(int l, const std::vector<int>& halos) {
+        const BW::Roi<3> roi({0,0,0}, data_.shape());
+        const BW::Blocking<3> cores(roi, Shape(l, l, l));
+        std::vector<BW::Blocking<3> > haloed;
+        for(int h : halos) {
+            haloed.push_back(BW::Blocking<3>(roi, Shape(l, l, l), Shape(h, h, h)));
+        }
+
+        const std::vector<size_t> order = BlockSampler::sample(cores.numBlocks(), options_.sampleBlocks);
+        const size_t n = order.size();
+
+        // one slot per (block, halo), summed afterwards
+        std::vector<std::vector<HaloResult> > perBlock(n, std::vector<HaloResult>(halos.size()));
+        sampler_.forEach(n, [&](size_t k) {
+            measureBlock(cores, haloed, order[k], perBlock[k]);
+        });
+
+        std::vector<HaloResult> results(halos.size());
+        for(size_t j=0; j<halos.size(); ++j) {
+            HaloResult& r = results[j];
+            r.L = l;
+            r.halo = halos[j];
+            r.blocks = n;
+            for(size_t k=0; k<n; ++k) {
+                const HaloResult& b = perBlock[k][j];
+                r.coreBytes += b.coreBytes;
+                r.haloBytes += b.haloBytes;
+                r.storedCore += b.storedCore;
+                r.storedFull += b.storedFull;
+                r.storedSlabs += b.storedSlabs;
+                r.compressCoreMs += b.compressCoreMs;
+                r.compressFullMs += b.compressFullMs;
+                r.compressSlabsMs += b.compressSlabsMs;
+                r.readReassembleMs += b.readReassembleMs;
+                r.readFullMs += b.readFullMs;
+                r.readSlabsMs += b.readSlabsMs;
+            }
+        }
+        return results;
+    }
+
+    private:
+    CompressionStatistics measure(const BW::Roi<3>& roi) {
+        return sampler_.measure(roi);
+    }
+
+    void measureBlock(const BW::Blocking<3>& cores, const std::vector<BW::Blocking<3> >& haloed,
+                      size_t i, std::vector<HaloResult>& results) {
+        const BW::Roi<3>::V coord = cores.blockCoordinate(i);
+        const BW::Roi<3> core = cores[i].second;
+        const CompressionStatistics c = measure(core);
+
+        // decompression time of the upper neighbours' cores, by piece index;
+        // every halo width (<= L) reaches into the same neighbours
+        double neighbourMs[8];
+        std::fill(neighbourMs, neighbourMs + 8, -1.0);
+
+        for(size_t j=0; j<haloed.size(); ++j) {
+            const BW::Roi<3> halo = haloed[j].blockRoi(coord);
+            HaloResult& r = results[j];
+            r.coreBytes = core.size()*sizeof(uint32_t);
+            r.haloBytes = halo.size()*sizeof(uint32_t);
+            r.storedCore = c.sizeBytesCompressed;
+            r.compressCoreMs = c.timeCompress;
+
+            const CompressionStatistics full = measure(halo);
+            r.storedFull = full.sizeBytesCompressed;
+            r.compressFullMs = full.timeCompress;
+            r.readFullMs = full.timeUncompress;
+
+            r.storedSlabs = c.sizeBytesCompressed;
+            r.compressSlabsMs = c.timeCompress;
+            double slabsMs = c.timeUncompress;
+            double reassembleMs = c.timeUncompress;
+            const std::vector<std::pair<int, BW::Roi<3> > > pieces = shellPieces(core, halo);
+            for(const std::pair<int, BW::Roi<3> >& piece : pieces) {
+                const CompressionStatistics s = measure(piece.second);
+                r.storedSlabs += s.sizeBytesCompressed;
+                r.compressSlabsMs += s.timeCompress;
+                slabsMs += s.timeUncompress;
+
+                double& neighbour = neighbourMs[piece.first];
+                if(neighbour < 0) {
+                    BW::Roi<3>::V x = coord;
+                    for(int d=0; d<3; ++d) {
+                        x[d] += (piece.first >> d) & 1;
+                    }
+                    neighbour = measure(cores.blockRoi(x)).timeUncompress;
+                }
+                reassembleMs += neighbour;
+            }
+
+            // both assembling layouts copy the core and the pieces into place
+            const double copyMs = assemble(core, halo, pieces);
+            r.readSlabsMs = slabsMs + copyMs;
+            r.readReassembleMs = reassembleMs + copyMs;
+        }
+    }
+
+    /** time in ms to copy 'core' and 'pieces' into a block of shape halo.shape() */
+    double assemble(const BW::Roi<3>& core, const BW::Roi<3>& halo,
+                    const std::vector<std::pair<int, BW::Roi<3> > >& pieces) {
+        BlockBufferPool::Handle buffer = blockBuffers_.acquire(halo.size());
+        vigra::MultiArrayView<3, uint32_t> out(halo.shape(), buffer->data());
+        Stopwatch t;
+        out.subarray(core.p - halo.p, core.q - halo.p).copy(data_.subarray(core.p, core.q));
+        for(const std::pair<int, BW::Roi<3> >& piece : pieces) {
+            const BW::Roi<3>& p = piece.second;
+            out.subarray(p.p - halo.p, p.q - halo.p).copy(data_.subarray(p.p, p.q));
+        }
+        return t.elapsedMs();
+    }
+
+    const vigra::MultiArrayView<3, uint32_t>& data_;
+    const HaloOptions& options_;
+    BlockSampler sampler_;
+    /** for the assembled haloed blocks */
+    BlockBufferPool blockBuffers_;
+};
+
+} /* anonymous namespace */
+
+std::vector<HaloResult> measureHalos(const vigra::MultiArrayView<3, uint32_t>& data,
+                                     const HaloOptions& options) {
+    using std::cout; using std::endl; using std::flush;
+
+    HaloMeasurement measurement(data, options);
+    std::vector<HaloResult> results;
+    for(int l : options.ls) {
+        std::vector<int> halos;
+        for(int h : options.halos) {
+            if(h >= 1 && h <= l) {
+                halos.push_back(h);
+            }
+        }
+        if(l < 1 || halos.empty()) {
+            continue;
+        }
+        cout << "\r  L = " << l << flush;
+        const std::vector<HaloResult> r = measurement.run(l, halos);
+        results.insert(results.end(), r.begin(), r.end());
+    }
+    cout << endl;
+    return results;
+}
+
+void haloStatistics(const std::string& tgFile, const HaloOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl; using std::setw;
+
+    MultiArray<3, uint32_t> data;
+    std::string name;
+    readFirstDataset(tgFile, data, name);
+    cout << "* halo layouts for " << name << " " << data.shape()
+         << " with " << toString(options.codec) << ", " << options.sampleBlocks
+         << " blocks per L" << endl;
+
+    const std::vector<HaloResult> results = measureHalos(data, options);
+
+    std::ofstream file("halo.txt", std::ios::trunc);
+    file /* 0 */ << "L "
+         /* 1 */ << "halo "
+         /* 2 */ << "blocks "
+         /* 3 */ << "coreBytes "
+         /* 4 */ << "haloBytes "
+         /* 5 */ << "storedCore "
+         /* 6 */ << "storedFull "
+         /* 7 */ << "storedSlabs "
+         /* 8 */ << "MBPerS_compress_core "
+         /* 9 */ << "MBPerS_compress_full "
+         /* 10 */ << "MBPerS_compress_slabs "
+         /* 11 */ << "MBPerS_read_reassemble "
+         /* 12 */ << "MBPerS_read_full "
+         /* 13 */ << "MBPerS_read_slabs"
+                  << endl;
+    cout << "  storage relative to the cores, reads in haloed MB/s and speedup over reassembling:" << endl;
+    cout << "  " << setw(4) << "L" << " " << setw(4) << "halo"
+         << " | " << setw(8) << "full" << " " << setw(8) << "slabs"
+         << " | " << setw(10) << "reassemble" << " " << setw(10) << "full" << " " << setw(10) << "slabs"
+         << " | " << setw(8) << "full" << " " << setw(8) << "slabs" << endl;
+    for(const HaloResult& r : results) {
+        const double compressCore = MBPerS(r.coreBytes, r.compressCoreMs);
+        const double compressFull = MBPerS(r.coreBytes, r.compressFullMs);
+        const double compressSlabs = MBPerS(r.coreBytes, r.compressSlabsMs);
+        const double readReassemble = MBPerS(r.haloBytes, r.readReassembleMs);
+        const double readFull = MBPerS(r.haloBytes, r.readFullMs);
+        const double readSlabs = MBPerS(r.haloBytes, r.readSlabsMs);
+        file /* 0 */ << r.L << " "
+             /* 1 */ << r.halo << " "
+             /* 2 */ << r.blocks << " "
+             /* 3 */ << r.coreBytes << " "
+             /* 4 */ << r.haloBytes << " "
+             /* 5 */ << r.storedCore << " "
+             /* 6 */ << r.storedFull << " "
+             /* 7 */ << r.storedSlabs << " "
+             /* 8 */ << compressCore << " "
+             /* 9 */ << compressFull << " "
+             /* 10 */ << compressSlabs << " "
+             /* 11 */ << readReassemble << " "
+             /* 12 */ << readFull << " "
+             /* 13 */ << readSlabs
+                      << endl;
+        const double core = r.storedCore > 0 ? r.storedCore : 1.0;
+        cout << "  " << setw(4) << r.L << " " << setw(4) << r.halo
+             << " | " << setw(8) << r.storedFull/core << " " << setw(8) << r.storedSlabs/core
+             << " | " << setw(10) << readReassemble << " " << setw(10) << readFull << " " << setw(10) << readSlabs
+             << " | " << setw(8) << (r.readFullMs > 0 ? r.readReassembleMs/r.readFullMs : 0.0)
+             << " " << setw(8) << (r.readSlabsMs > 0 ? r.readReassembleMs/r.readSlabsMs : 0.0) << endl;
+    }
+}
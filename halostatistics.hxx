@@ -0,0 +1,109 @@
+#ifndef HALOSTATISTICS_HXX
+#define HALOSTATISTICS_HXX
+
+#include <string>
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "benchmark.hxx"
+#include "compressors.hxx"
+
+/*
+ * Blocks with halos (BW::Blocking's overlap, which extends every block by
+ * the halo width on its upper side) can be served in three ways:
+ *
+ *   reassemble  store only the cores; a read decodes the core and every
+ *               upper neighbour the halo reaches into
+ *   full        store every block with its halo
+ *   slabs       store the cores, and per block the halo shell outside its
+ *               core as separate pieces (3 face slabs, 3 edges, 1 corner);
+ *               a read decodes the core and its pieces
+ */
+
+struct HaloOptions {
+    HaloOptions()
+      : ls({32, 64, 128})
+      , halos({1, 2, 4})
+      , codec(vigra::LZ4)
+      , nthreads(1)
+      , codecThreads(1)
+      , sampleBlocks(64)
+      {}
+
+    /** core block edge lengths */
+    std::vector<int> ls;
+    /** halo widths, the same along every axis; widths > L are skipped */
+    std::vector<int> halos;
+    /** codec all layouts are measured with */
+    Codec codec;
+    /** number of worker threads measuring sampled blocks */
+    int nthreads;
+    /** number of threads each codec may use internally */
+    int codecThreads;
+    TimingOptions timing;
+    /** number of randomly chosen blocks measured per L */
+    size_t sampleBlocks;
+};
+
+/**
+ * totals over the sampled blocks of one L and halo width
+ */
+struct HaloResult {
+    HaloResult()
+      : L(0)
+      , halo(0)
+      , blocks(0)
+      , coreBytes(0)
+      , haloBytes(0)
+      , storedCore(0)
+      , storedFull(0)
+      , storedSlabs(0)
+      , compressCoreMs(0)
+      , compressFullMs(0)
+      , compressSlabsMs(0)
+      , readReassembleMs(0)
+      , readFullMs(0)
+      , readSlabsMs(0)
+      {}
+
+    int L;
+    int halo;
+    size_t blocks;
+    /** uncompressed bytes of the cores */
+    double coreBytes;
+    /** uncompressed bytes of the haloed blocks, i.e. of what a read returns */
+    double haloBytes;
+    /** compressed bytes of the cores (the reassemble layout) */
+    double storedCore;
+    /** compressed bytes of the haloed blocks */
+    double storedFull;
+    /** compressed bytes of the cores and their halo pieces */
+    double storedSlabs;
+    double compressCoreMs;
+    double compressFullMs;
+    double compressSlabsMs;
+    /**
+     * time to produce the haloed blocks: decompression of every stored
+     * piece read plus copying them into place
+     */
+    double readReassembleMs;
+    double readFullMs;
+    double readSlabsMs;
+};
+
+/**
+ * measure the three layouts for every L and halo width on (the same, per
+ * L) randomly chosen blocks of 'data'
+ */
+std::vector<HaloResult> measureHalos(const vigra::MultiArrayView<3, uint32_t>& data,
+                                     const HaloOptions& options);
+
+/**
+ * run measureHalos on the first topological grid dataset of 'tgFile';
+ * prints the storage overhead and read speedup of storing halos compared
+ * with reassembling them and writes all totals to halo.txt
+ */
+void haloStatistics(const std::string& tgFile, const HaloOptions& options);
+
+#endif /* HALOSTATISTICS_HXX */
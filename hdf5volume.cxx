@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "hdf5volume.hxx"
+#include "trace.hxx"
+
+HDF5Volume::HDF5Volume(const std::string& file, const std::string& dataset)
+    : file_(file, vigra::HDF5File::OpenReadOnly)
+    , dataset_(dataset)
+    , chunked_(false)
+    , bytesRead_(0)
+{
+    using namespace vigra;
+
+    if(file_.getDatasetDimensions(dataset_) != 3) {
+        throw std::runtime_error("HDF5Volume: " + dataset_ + " is not 3-dimensional");
+    }
+    ArrayVector<hsize_t> s = file_.getDatasetShape(dataset_);
+    for(int i=0; i<3; ++i) {
+        shape_[i] = s[i];
+    }
+    chunkShape_ = shape_;
+
+    HDF5Handle handle = file_.getDatasetHandle(dataset_);
+    HDF5Handle plist(H5Dget_create_plist(handle), &H5Pclose,
+                     "HDF5Volume: could not get dataset creation property list");
+    if(H5Pget_layout(plist) == H5D_CHUNKED) {
+        hsize_t c[3];
+        H5Pget_chunk(plist, 3, c);
+        // HDF5 order is the reverse of vigra order
+        for(int i=0; i<3; ++i) {
+            chunkShape_[i] = c[2-i];
+        }
+        chunked_ = true;
+    }
+}
+
+void HDF5Volume::read(const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t> out) {
+    TRACE_SPAN("hdf5 read");
+    Shape offset = roi.p;
+    Shape shape = roi.shape();
+    file_.readBlock(dataset_, offset, shape, out);
+    bytesRead_ += roi.size()*sizeof(uint32_t);
+    trace::add(trace::BYTES_READ, roi.size()*sizeof(uint32_t));
+}
+
+namespace {
+    vigra::MultiArrayIndex gcd(vigra::MultiArrayIndex a, vigra::MultiArrayIndex b) {
+        while(b != 0) {
+            vigra::MultiArrayIndex t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+}
+
+HDF5Volume::Shape brickShape(
+    const HDF5Volume::Shape& shape,
+    const HDF5Volume::Shape& blockShape,
+    const HDF5Volume::Shape& chunkShape,
+    size_t budgetBytes
+) {
+    typedef vigra::MultiArrayIndex Index;
+    const size_t budget = budgetBytes / sizeof(uint32_t);
+
+    HDF5Volume::Shape brick = blockShape;
+    for(int d=0; d<3; ++d) {
+        // the whole extent along d, rounded up to full blocks
+        const Index extent = (shape[d] + blockShape[d] - 1) / blockShape[d] * blockShape[d];
+
+        size_t rest = 1;
+        for(int i=0; i<3; ++i) {
+            if(i != d) { rest *= brick[i]; }
+        }
+        const Index affordable = std::min<Index>(extent, budget / rest);
+
+        Index unit = blockShape[d] / gcd(blockShape[d], chunkShape[d]) * chunkShape[d];
+        if(unit > affordable) {
+            unit = blockShape[d];
+        }
+        if(unit <= affordable) {
+            brick[d] = std::max(blockShape[d], affordable / unit * unit);
+        }
+    }
+    return brick;
+}
@@ -0,0 +1,71 @@
+#ifndef HDF5VOLUME_HXX
+#define HDF5VOLUME_HXX
+
+#include <string>
+
+#include <vigra/hdf5impex.hxx>
+#include <vigra/multi_array.hxx>
+
+#include "roi.h"
+#include "volume.hxx"
+
+/**
+ * Reads hyperslabs of a 3-D uint32 dataset without loading the whole
+ * dataset. Shapes are in vigra axis order (axis 0 fastest in memory,
+ * i.e. reversed with respect to the HDF5 dimensions).
+ *
+ * Not thread-safe; use one reader per thread.
+ */
+class HDF5Volume : public Volume {
+    public:
+
+    /**
+     * open 'dataset' (may contain groups, e.g. "blocks/b0/topological-grid")
+     * in 'file' read-only
+     */
+    HDF5Volume(const std::string& file, const std::string& dataset);
+
+    const Shape& shape() const override { return shape_; }
+
+    /**
+     * chunk shape of the dataset; equal to shape() for contiguous datasets
+     */
+    const Shape& chunkShape() const override { return chunkShape_; }
+
+    bool isChunked() const override { return chunked_; }
+
+    /**
+     * read the voxels of 'roi' into 'out', which must have shape roi.shape()
+     */
+    void read(const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t> out) override;
+
+    /** number of payload bytes read so far */
+    size_t bytesRead() const override { return bytesRead_; }
+
+    private:
+    vigra::HDF5File file_;
+    std::string dataset_;
+    Shape shape_;
+    Shape chunkShape_;
+    bool chunked_;
+    size_t bytesRead_;
+};
+
+/**
+ * Shape of the bricks in which a volume of shape 'shape' is streamed so
+ * that one brick takes at most 'budgetBytes' bytes.
+ *
+ * Bricks are multiples of 'blockShape' (no sub-block straddles two bricks)
+ * and, where the budget allows, of the dataset's 'chunkShape', so every
+ * chunk is decoded only once. They grow along axis 0 first, which is
+ * contiguous on disk. A single block is returned if even that exceeds the
+ * budget.
+ */
+HDF5Volume::Shape brickShape(
+    const HDF5Volume::Shape& shape,
+    const HDF5Volume::Shape& blockShape,
+    const HDF5Volume::Shape& chunkShape,
+    size_t budgetBytes
+);
+
+#endif /* HDF5VOLUME_HXX */
@@ -0,0 +1,233 @@
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <vigra/accumulator.hxx>
+
+#include "labelcounts.hxx"
+#include "threadpool.hxx"
+
+std::string toString(const CountKernel k) {
+    switch(k) {
+        case ACCUMULATOR_KERNEL:
+        return "ACCUMULATOR";
+        case SCALAR_KERNEL:
+        return "SCALAR";
+        case RUNS_KERNEL:
+        return "RUNS";
+    }
+    return "";
+}
+
+std::map<std::string, CountKernel> countKernelList() {
+    std::map<std::string, CountKernel> kl;
+    kl["accumulator"] = ACCUMULATOR_KERNEL;
+    kl["scalar"]      = SCALAR_KERNEL;
+    kl["runs"]        = RUNS_KERNEL;
+    return kl;
+}
+
+void LabelCounts::add(const uint32_t* labels, size_t n, CountKernel kernel) {
+    switch(kernel) {
+        case ACCUMULATOR_KERNEL:
+        addAccumulator(labels, n);
+        break;
+        case SCALAR_KERNEL:
+        addScalar(labels, n);
+        break;
+        case RUNS_KERNEL:
+        addRuns(labels, n);
+        break;
+    }
+}
+
+void LabelCounts::addAccumulator(const uint32_t* labels, size_t n) {
+    using namespace vigra;
+    using namespace vigra::acc;
+    if(n == 0) {
+        return;
+    }
+    const MultiArrayView<3, uint32_t> seg(Shape3(n, 1, 1), const_cast<uint32_t*>(labels));
+    AccumulatorChainArray<CoupledArrays<3, uint32_t, uint32_t>,
+                          Select<DataArg<1>, LabelArg<2>, Count> > a;
+    auto start = createCoupledIterator(seg, seg);
+    auto end = start.getEndIterator();
+    extractFeatures(start, end, a);
+    for(size_t i=0; i<=a.maxRegionLabel(); ++i) {
+        const size_t c = static_cast<size_t>(get<Count>(a, i));
+        if(c > 0) {
+            addCount(static_cast<uint32_t>(i), c);
+        }
+    }
+}
+
+void LabelCounts::addScalar(const uint32_t* labels, size_t n) {
+    for(size_t i=0; i<n; ++i) {
+        addCount(labels[i], 1);
+    }
+}
+
+void LabelCounts::addRuns(const uint32_t* labels, size_t n) {
+    // supervoxels are compact, so labels come in runs along axis 0;
+    // each run costs one table update
+    size_t i = 0;
+    while(i < n) {
+        const uint32_t v = labels[i];
+        size_t j = i+1;
+#ifdef __SSE2__
+        // compare 4 labels at a time against the run's label
+        const __m128i run = _mm_set1_epi32(static_cast<int>(v));
+        while(j+4 <= n) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(labels + j));
+            const int equal = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, run)));
+            if(equal != 0xF) {
+                j += __builtin_ctz(~equal & 0xF);
+                break;
+            }
+            j += 4;
+        }
+#endif
+        // the scalar loop finishes a run the vector loop could not
+        while(j < n && labels[j] == v) {
+            ++j;
+        }
+        addCount(v, j-i);
+        i = j;
+    }
+}
+
+void LabelCounts::growDense(uint32_t label) {
+    if(label >= denseLimit_) {
+        // switch to hashing, keeping what was counted so far
+        for(size_t i=0; i<denseCounts_.size(); ++i) {
+            if(denseCounts_[i] > 0) {
+                hashed_[static_cast<uint32_t>(i)] += denseCounts_[i];
+            }
+        }
+        std::vector<size_t>().swap(denseCounts_);
+        dense_ = false;
+        return;
+    }
+    // grow geometrically so that increasing labels don't resize every time
+    const size_t size = std::min(denseLimit_, std::max(size_t(label)+1, 2*denseCounts_.size()));
+    denseCounts_.resize(size, 0);
+}
+
+void LabelCounts::merge(const LabelCounts& other) {
+    if(other.dense_) {
+        for(size_t i=0; i<other.denseCounts_.size(); ++i) {
+            if(other.denseCounts_[i] > 0) {
+                addCount(static_cast<uint32_t>(i), other.denseCounts_[i]);
+            }
+        }
+    }
+    else {
+        for(const auto& c : other.hashed_) {
+            addCount(c.first, c.second);
+        }
+    }
+}
+
+LabelCounts LabelCounts::merge(const std::vector<LabelCounts>& parts, ThreadPool& pool) {
+    LabelCounts total(parts.empty() ? DEFAULT_DENSE_LIMIT : parts.front().denseLimit_);
+    bool dense = true;
+    uint32_t maxLabel = 0;
+    for(const LabelCounts& p : parts) {
+        dense = dense && p.dense_;
+        maxLabel = std::max(maxLabel, p.maxLabel_);
+    }
+    if(!dense || parts.empty()) {
+        for(const LabelCounts& p : parts) {
+            total.merge(p);
+        }
+        return total;
+    }
+
+    // every worker sums up a range of labels over all parts, so no two
+    // workers ever write to the same entry
+    total.denseCounts_.resize(size_t(maxLabel)+1, 0);
+    total.maxLabel_ = maxLabel;
+    const size_t n = total.denseCounts_.size();
+    const size_t ranges = 4*pool.size();
+    size_t* counts = total.denseCounts_.data();
+    for(size_t k=0; k<ranges; ++k) {
+        const size_t b = n*k/ranges;
+        const size_t e = n*(k+1)/ranges;
+        pool.submit([&parts, counts, b, e]() {
+            for(const LabelCounts& p : parts) {
+                const size_t pe = std::min(e, p.denseCounts_.size());
+                for(size_t i=b; i<pe; ++i) {
+                    counts[i] += p.denseCounts_[i];
+                }
+            }
+        });
+    }
+    pool.wait();
+    return total;
+}
+
+size_t LabelCounts::count(uint32_t label) const {
+    if(dense_) {
+        return label < denseCounts_.size() ? denseCounts_[label] : 0;
+    }
+    auto it = hashed_.find(label);
+    return it == hashed_.end() ? 0 : it->second;
+}
+
+std::vector<size_t> LabelCounts::sizes() const {
+    std::vector<size_t> s;
+    if(dense_) {
+        for(size_t i=1; i<denseCounts_.size(); ++i) {
+            if(denseCounts_[i] > 0) {
+                s.push_back(denseCounts_[i]);
+            }
+        }
+    }
+    else {
+        s.reserve(hashed_.size());
+        for(const auto& c : hashed_) {
+            if(c.first > 0 && c.second > 0) {
+                s.push_back(c.second);
+            }
+        }
+    }
+    return s;
+}
+
+bool LabelCounts::operator==(const LabelCounts& other) const {
+    if(maxLabel_ != other.maxLabel_) {
+        return false;
+    }
+    size_t labels = 0;
+    if(dense_) {
+        for(size_t i=0; i<denseCounts_.size(); ++i) {
+            if(denseCounts_[i] == 0) {
+                continue;
+            }
+            ++labels;
+            if(other.count(static_cast<uint32_t>(i)) != denseCounts_[i]) {
+                return false;
+            }
+        }
+    }
+    else {
+        for(const auto& c : hashed_) {
+            ++labels;
+            if(other.count(c.first) != c.second) {
+                return false;
+            }
+        }
+    }
+    // all of our labels match, so the other one must not have more
+    size_t otherLabels = 0;
+    if(other.dense_) {
+        otherLabels = other.denseCounts_.size() - std::count(other.denseCounts_.begin(),
+                                                             other.denseCounts_.end(), size_t(0));
+    }
+    else {
+        otherLabels = other.hashed_.size();
+    }
+    return labels == otherLabels;
+}
@@ -0,0 +1,116 @@
+#ifndef LABELCOUNTS_HXX
+#define LABELCOUNTS_HXX
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * ways of counting voxels per label
+ */
+enum CountKernel {
+    /**
+     * vigra's AccumulatorChainArray with a Count accumulator, the reference
+     * (its table always spans all labels up to the largest one)
+     */
+    ACCUMULATOR_KERNEL,
+    /** one table update per voxel */
+    SCALAR_KERNEL,
+    /** one table update per run of equal labels, runs found with SSE2 */
+    RUNS_KERNEL
+};
+
+std::string toString(const CountKernel k);
+
+/**
+ * all kernels by their lower case name
+ */
+std::map<std::string, CountKernel> countKernelList();
+
+/**
+ * Voxel counts per label. Accumulators of disjoint parts of a volume are
+ * merged by adding them up.
+ *
+ * Counts are kept in a dense table indexed by label as long as the largest
+ * label is below 'denseLimit', and in a hash table otherwise (e.g. for
+ * segmentations with huge or sparse label values).
+ */
+class LabelCounts {
+    public:
+    /** default largest dense table: 2^24 labels, 128 MB */
+    static const size_t DEFAULT_DENSE_LIMIT = size_t(1) << 24;
+
+    explicit LabelCounts(size_t denseLimit = DEFAULT_DENSE_LIMIT)
+      : denseLimit_(denseLimit)
+      , maxLabel_(0)
+      , dense_(true)
+      {}
+
+    /**
+     * count the 'n' labels starting at 'labels'
+     */
+    void add(const uint32_t* labels, size_t n, CountKernel kernel = RUNS_KERNEL);
+
+    /**
+     * add the counts of 'other' to these
+     */
+    void merge(const LabelCounts& other);
+
+    /**
+     * merge 'parts' on 'pool'; dense tables are split into label ranges
+     * which are summed up by different workers
+     */
+    static LabelCounts merge(const std::vector<LabelCounts>& parts, ThreadPool& pool);
+
+    /** largest label seen so far (0 if none) */
+    uint32_t maxLabel() const { return maxLabel_; }
+
+    bool isDense() const { return dense_; }
+
+    size_t count(uint32_t label) const;
+
+    /**
+     * the counts of all labels > 0 that occur, in no particular order
+     */
+    std::vector<size_t> sizes() const;
+
+    /**
+     * whether both hold the same count for every label
+     */
+    bool operator==(const LabelCounts& other) const;
+
+    private:
+    void addCount(uint32_t label, size_t n) {
+        if(label > maxLabel_) {
+            maxLabel_ = label;
+        }
+        if(dense_ && label >= denseCounts_.size()) {
+            growDense(label);
+        }
+        if(dense_) {
+            denseCounts_[label] += n;
+        }
+        else {
+            hashed_[label] += n;
+        }
+    }
+
+    /** make room for 'label' in the dense table, or switch to hashing */
+    void growDense(uint32_t label);
+
+    void addAccumulator(const uint32_t* labels, size_t n);
+    void addScalar(const uint32_t* labels, size_t n);
+    void addRuns(const uint32_t* labels, size_t n);
+
+    size_t denseLimit_;
+    uint32_t maxLabel_;
+    bool dense_;
+    std::vector<size_t> denseCounts_;
+    std::unordered_map<uint32_t, size_t> hashed_;
+};
+
+#endif /* LABELCOUNTS_HXX */
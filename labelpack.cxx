@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "labelpack.hxx"
+
+namespace {
+
+/** number of indices packed together, 32 per lane */
+const size_t GROUP = 128;
+
+size_t numGroups(size_t n) {
+    return (n + GROUP - 1) / GROUP;
+}
+
+/**
+ * sorted distinct values of in[0..n); runs of equal values are looked up once
+ */
+void buildDictionary(const uint32_t* in, size_t n, std::vector<uint32_t>& dictionary) {
+    static thread_local std::unordered_set<uint32_t> seen;
+    seen.clear();
+    dictionary.clear();
+    if(n == 0) {
+        return;
+    }
+    uint32_t last = in[0];
+    seen.insert(last);
+    for(size_t i=1; i<n; ++i) {
+        if(in[i] != last) {
+            last = in[i];
+            seen.insert(last);
+        }
+    }
+    dictionary.assign(seen.begin(), seen.end());
+    std::sort(dictionary.begin(), dictionary.end());
+}
+
+/**
+ * pack the 128 indices 'idx' at 'bits' bits each into bits*4 words
+ */
+void packGroup(const uint32_t* idx, int bits, uint32_t* out) {
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    __m128i* o = reinterpret_cast<__m128i*>(out);
+    int shift = 0;
+    for(size_t i=0; i<GROUP/4; ++i) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(idx + 4*i));
+        acc = _mm_or_si128(acc, _mm_sll_epi32(v, _mm_cvtsi32_si128(shift)));
+        shift += bits;
+        if(shift >= 32) {
+            _mm_storeu_si128(o++, acc);
+            shift -= 32;
+            acc = shift ? _mm_srl_epi32(v, _mm_cvtsi32_si128(bits - shift)) : _mm_setzero_si128();
+        }
+    }
+#else
+    for(int lane=0; lane<4; ++lane) {
+        uint32_t acc = 0;
+        uint32_t* o = out + lane;
+        int shift = 0;
+        for(size_t i=0; i<GROUP/4; ++i) {
+            const uint32_t v = idx[4*i + lane];
+            acc |= v << shift;
+            shift += bits;
+            if(shift >= 32) {
+                *o = acc;
+                o += 4;
+                shift -= 32;
+                acc = shift ? v >> (bits - shift) : 0;
+            }
+        }
+    }
+#endif
+}
+
+/**
+ * inverse of packGroup
+ */
+void unpackGroup(const uint32_t* in, int bits, uint32_t* idx) {
+    const uint32_t mask = bits == 32 ? ~uint32_t(0) : (uint32_t(1) << bits) - 1;
+#ifdef __SSE2__
+    const __m128i* w = reinterpret_cast<const __m128i*>(in);
+    const __m128i m = _mm_set1_epi32(mask);
+    __m128i cur = _mm_loadu_si128(w);
+    int k = 0;
+    int shift = 0;
+    for(size_t i=0; i<GROUP/4; ++i) {
+        __m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128(shift));
+        shift += bits;
+        if(shift >= 32) {
+            shift -= 32;
+            if(++k < bits) {
+                cur = _mm_loadu_si128(w + k);
+            }
+            if(shift) {
+                v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128(bits - shift)));
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(idx + 4*i), _mm_and_si128(v, m));
+    }
+#else
+    for(int lane=0; lane<4; ++lane) {
+        const uint32_t* w = in + lane;
+        uint32_t cur = w[0];
+        int k = 0;
+        int shift = 0;
+        for(size_t i=0; i<GROUP/4; ++i) {
+            uint32_t v = cur >> shift;
+            shift += bits;
+            if(shift >= 32) {
+                shift -= 32;
+                if(++k < bits) {
+                    cur = w[4*k];
+                }
+                if(shift) {
+                    v |= cur << (bits - shift);
+                }
+            }
+            idx[4*i + lane] = v & mask;
+        }
+    }
+#endif
+}
+
+/**
+ * write the packed dictionary indices of in[0..n) to 'out'
+ */
+void encode(const uint32_t* in, size_t n,
+            const std::vector<uint32_t>& dictionary, int bits, uint32_t* out) {
+    if(bits == 0) {
+        return;
+    }
+    uint32_t idx[GROUP];
+    uint32_t last = dictionary[0];
+    uint32_t lastIndex = 0;
+    const size_t groups = numGroups(n);
+    for(size_t g=0; g<groups; ++g) {
+        const size_t begin = g*GROUP;
+        const size_t count = std::min(GROUP, n - begin);
+        for(size_t j=0; j<count; ++j) {
+            const uint32_t v = in[begin + j];
+            if(v != last) {
+                last = v;
+                lastIndex = std::lower_bound(dictionary.begin(), dictionary.end(), v)
+                          - dictionary.begin();
+            }
+            idx[j] = lastIndex;
+        }
+        std::fill(idx + count, idx + GROUP, 0);
+        packGroup(idx, bits, out + g*4*bits);
+    }
+}
+
+/**
+ * reconstruct n voxels from a dictionary of 'd' labels and the packed words
+ */
+void decode(const uint32_t* dictionary, size_t d, int bits,
+            const uint32_t* words, size_t n, uint32_t* dest) {
+    if(d == 0) {
+        return;
+    }
+    if(bits == 0) {
+        std::fill(dest, dest + n, dictionary[0]);
+        return;
+    }
+    uint32_t idx[GROUP];
+    const size_t groups = numGroups(n);
+    for(size_t g=0; g<groups; ++g) {
+        unpackGroup(words + g*4*bits, bits, idx);
+        const size_t begin = g*GROUP;
+        const size_t count = std::min(GROUP, n - begin);
+        uint32_t largest = 0;
+        for(size_t j=0; j<count; ++j) {
+            largest = std::max(largest, idx[j]);
+        }
+        if(largest >= d) {
+            throw std::runtime_error("deserializeLabels: index outside the dictionary");
+        }
+        for(size_t j=0; j<count; ++j) {
+            dest[begin + j] = dictionary[idx[j]];
+        }
+    }
+}
+
+} /* anonymous namespace */
+
+size_t PackedLabels::sizeBytes() const {
+    return 2*sizeof(uint32_t) + (dictionary.size() + words.size())*sizeof(uint32_t);
+}
+
+int packWidth(size_t n) {
+    int bits = 0;
+    while(bits < 32 && (size_t(1) << bits) < n) {
+        ++bits;
+    }
+    return bits;
+}
+
+void packLabels(const vigra::MultiArrayView<3, uint32_t>& src, PackedLabels& packed) {
+    const size_t n = src.size();
+    packed.shape = src.shape();
+    buildDictionary(src.data(), n, packed.dictionary);
+    packed.bits = packWidth(packed.dictionary.size());
+    packed.words.resize(numGroups(n)*4*packed.bits);
+    encode(src.data(), n, packed.dictionary, packed.bits, packed.words.data());
+}
+
+void unpackLabels(const PackedLabels& packed, uint32_t* dest) {
+    const size_t n = packed.shape[0]*packed.shape[1]*packed.shape[2];
+    decode(packed.dictionary.data(), packed.dictionary.size(), packed.bits,
+           packed.words.data(), n, dest);
+}
+
+size_t packedLabelsBound(size_t elements) {
+    // header, at most 'elements' labels and at most 32 bits per index
+    return (2 + elements + numGroups(elements)*GROUP)*sizeof(uint32_t);
+}
+
+size_t serializeLabels(const vigra::MultiArrayView<3, uint32_t>& src, char* dest) {
+    static thread_local std::vector<uint32_t> dictionary;
+    const size_t n = src.size();
+    buildDictionary(src.data(), n, dictionary);
+    const int bits = packWidth(dictionary.size());
+
+    uint32_t* out = reinterpret_cast<uint32_t*>(dest);
+    out[0] = dictionary.size();
+    out[1] = bits;
+    std::memcpy(out + 2, dictionary.data(), dictionary.size()*sizeof(uint32_t));
+    uint32_t* words = out + 2 + dictionary.size();
+    encode(src.data(), n, dictionary, bits, words);
+    return (2 + dictionary.size() + numGroups(n)*4*bits)*sizeof(uint32_t);
+}
+
+void deserializeLabels(const char* src, size_t size, size_t elements, uint32_t* dest) {
+    const uint32_t* in = reinterpret_cast<const uint32_t*>(src);
+    if(size < 2*sizeof(uint32_t)) {
+        throw std::runtime_error("deserializeLabels: truncated header");
+    }
+    const size_t d = in[0];
+    const uint32_t bits = in[1];
+    if(bits > 32 || d < 1 || (2 + d + numGroups(elements)*4*bits)*sizeof(uint32_t) > size) {
+        throw std::runtime_error("deserializeLabels: corrupt data");
+    }
+    decode(in + 2, d, bits, in + 2 + d, elements, dest);
+}
@@ -0,0 +1,68 @@
+#ifndef LABELPACK_HXX
+#define LABELPACK_HXX
+
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+/**
+ * A block of labels stored as the sorted dictionary of its distinct labels
+ * plus the dictionary index of every voxel, bit-packed at the minimal width.
+ *
+ * Indices are packed in groups of 128 values, interleaved over 4 lanes of
+ * 32-bit words (value i goes to lane i%4), so that packing and unpacking
+ * handle 4 values per SSE2 instruction. The last group is padded with zeros.
+ */
+struct PackedLabels {
+    PackedLabels()
+      : bits(0)
+      {}
+
+    /** size of the packed form (as written by serializeLabels) in bytes */
+    size_t sizeBytes() const;
+
+    vigra::MultiArrayShape<3>::type shape;
+    /** distinct labels of the block, sorted */
+    std::vector<uint32_t> dictionary;
+    /** bits per index: ceil(log2(dictionary.size())) */
+    int bits;
+    /** bits*4 words per group of 128 voxels */
+    std::vector<uint32_t> words;
+};
+
+/**
+ * number of bits needed to distinguish 'n' labels
+ */
+int packWidth(size_t n);
+
+/**
+ * encode the contiguous block 'src'
+ */
+void packLabels(const vigra::MultiArrayView<3, uint32_t>& src, PackedLabels& packed);
+
+/**
+ * decode 'packed' contiguously into 'dest'
+ */
+void unpackLabels(const PackedLabels& packed, uint32_t* dest);
+
+/**
+ * maximum number of bytes serializeLabels writes for 'elements' voxels
+ */
+size_t packedLabelsBound(size_t elements);
+
+/**
+ * encode the contiguous block 'src' into 'dest' as: number of labels,
+ * bits (both uint32), dictionary, packed words
+ *
+ * returns: the number of bytes written
+ */
+size_t serializeLabels(const vigra::MultiArrayView<3, uint32_t>& src, char* dest);
+
+/**
+ * decode the 'size' bytes written by serializeLabels for a block of
+ * 'elements' voxels into 'dest'; throws if they are not a valid encoding
+ * of that many voxels
+ */
+void deserializeLabels(const char* src, size_t size, size_t elements, uint32_t* dest);
+
+#endif /* LABELPACK_HXX */
@@ -0,0 +1,187 @@
+#ifndef PIPELINE_HXX
+#define PIPELINE_HXX
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "benchmark.hxx"
+#include "trace.hxx"
+
+/**
+ * Blocking FIFO queue with a fixed capacity.
+ */
+template<class T>
+class BoundedQueue {
+    public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity)
+        , closed_(false)
+    {}
+
+    /**
+     * append 't', waiting while the queue is full
+     *
+     * returns: false if the queue has been closed
+     */
+    bool push(T t) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+        if(closed_) {
+            return false;
+        }
+        items_.push_back(std::move(t));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    /**
+     * take the oldest item, waiting while the queue is empty
+     *
+     * returns: false if the queue has been closed and is drained
+     */
+    bool pop(T& t) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+        if(items_.empty()) {
+            return false;
+        }
+        t = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    /**
+     * wake up all waiting threads; no further pushes succeed
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+    private:
+    size_t capacity_;
+    bool closed_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+};
+
+/**
+ * Runs a producer on a background thread, 'depth' items ahead of the
+ * consumer.
+ *
+ * The prefetcher owns depth+1 items which are recycled: the producer fills
+ * a free item, the consumer gets it from next() and hands it back with the
+ * following call to next(). Memory is therefore bounded by depth+1 items,
+ * and items (e.g. arrays) keep their allocations between uses.
+ *
+ * With depth 0 there is no background thread; next() calls the producer
+ * directly.
+ */
+template<class T>
+class Prefetcher {
+    public:
+    /** fill the given item, return false if there is nothing left */
+    typedef std::function<bool(T&)> Producer;
+
+    Prefetcher(Producer produce, size_t depth)
+        : produce_(produce)
+        , items_(depth+1)
+        , free_(depth+1)
+        , full_(depth+1)
+        , current_(0)
+        , waitMs_(0.0)
+    {
+        for(T& item : items_) {
+            free_.push(&item);
+        }
+        if(depth > 0) {
+            thread_ = std::thread(&Prefetcher::run, this);
+        }
+    }
+
+    ~Prefetcher() {
+        free_.close();
+        full_.close();
+        if(thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    /**
+     * the next produced item, or 0 at the end; the item returned by the
+     * previous call must no longer be used. Rethrows exceptions thrown
+     * by the producer.
+     */
+    T* next() {
+        if(current_) {
+            free_.push(current_);
+            current_ = 0;
+        }
+        TRACE_SPAN("wait for input");
+        Stopwatch t;
+        T* item = 0;
+        if(!thread_.joinable()) {
+            free_.pop(item);
+            if(produce_(*item)) {
+                current_ = item;
+            }
+            else {
+                free_.push(item);
+            }
+        }
+        else if(full_.pop(item)) {
+            current_ = item;
+        }
+        waitMs_ += t.elapsedMs();
+        if(!current_ && error_) {
+            std::rethrow_exception(error_);
+        }
+        return current_;
+    }
+
+    /**
+     * total time the consumer spent waiting in next()
+     */
+    double waitMs() const { return waitMs_; }
+
+    private:
+    void run() {
+        trace::setThreadName("prefetch");
+        try {
+            T* item;
+            while(free_.pop(item)) {
+                if(!produce_(*item) || !full_.push(item)) {
+                    break;
+                }
+            }
+        }
+        catch(...) {
+            error_ = std::current_exception();
+        }
+        full_.close();
+    }
+
+    Producer produce_;
+    std::vector<T> items_;
+    BoundedQueue<T*> free_;
+    BoundedQueue<T*> full_;
+    T* current_;
+    double waitMs_;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+#endif /* PIPELINE_HXX */
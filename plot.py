@@ -2,10 +2,10 @@ from matplotlib import pyplot as plot
 from matplotlib.font_manager import FontProperties
 from matplotlib.lines import Line2D
 
-import glob
-import csv
 import numpy
-import os
+import struct
+
+RESULTS = "stats/small_supervoxels/stat.bin"
 
 #linestyles = ['_', '-', '--', ':']
 linestyles = ['-']
@@ -18,32 +18,67 @@ for m in Line2D.markers:
         pass
 colors = [(1.0, 0.0, 0.0), (0.0, 1.0, 0.0), (1.0, 1.0, 0.0), (0.0, 0.0, 1.0), (1.0, 0.0, 1.0), (0.5019607843137255, 0.5019607843137255, 0.0), (0.7529411764705882, 0.7529411764705882, 0.7529411764705882), (1.0, 0.4117647058823529, 0.7058823529411765), (0.4, 0.803921568627451, 0.6666666666666666), (0.6470588235294118, 0.16470588235294117, 0.16470588235294117), (0.0, 0.0, 0.5019607843137255), (1.0, 0.6470588235294118, 0.0), (0.6784313725490196, 1.0, 0.1843137254901961), (0.5019607843137255, 0.0, 0.5019607843137255), (0.9411764705882353, 0.9019607843137255, 0.5490196078431373)]
 
+def readResults(fname):
+    """codec names and columns (name -> array) of a file written by ResultSink"""
+    data = open(fname, 'rb').read()
+    assert data[:8] == b"CGPRES01", "%s is not a result file" % fname
+    pos = 8
+    nCodecs, = struct.unpack_from("<I", data, pos); pos += 4
+    codecs = []
+    for i in range(nCodecs):
+        codecs.append(data[pos:pos+32].split(b"\0")[0].decode()); pos += 32
+    nColumns, = struct.unpack_from("<I", data, pos); pos += 4
+    columns = []
+    for i in range(nColumns):
+        name = data[pos:pos+32].split(b"\0")[0].decode(); pos += 32
+        t, = struct.unpack_from("<I", data, pos); pos += 4
+        columns.append((name, ["<u4", "<u8", "<f8"][t]))
+    parts = dict((name, []) for name, t in columns)
+    while pos < len(data):
+        rows, = struct.unpack_from("<Q", data, pos); pos += 8
+        for name, t in columns:
+            a = numpy.frombuffer(data, dtype=t, count=rows, offset=pos)
+            parts[name].append(a)
+            pos += a.nbytes
+    result = {}
+    for name, t in columns:
+        result[name] = numpy.concatenate(parts[name]) if parts[name] else numpy.zeros(0, dtype=t)
+    return codecs, result
+
+def columnOf(r, name):
+    """a stored column, or one of the columns of the former stat_<codec>.txt files"""
+    MB = r["sizeBytesUncompressed"]/1024.0**2
+    if name == "compessionRatio":
+        return r["sizeBytesCompressed"]/r["sizeBytesUncompressed"]
+    if name == "msPerMB_compress":
+        return r["timeCompress"]/MB
+    if name == "msPerMB_uncompress":
+        return r["timeUncompress"]/MB
+    return r[name]
+
 def mkPlot(column, ylabel, outfile, yclip=None, only=None):
     plot.clf()
     plot.figure()
     
     print "make plot", outfile
-    fnames = sorted(glob.glob("stats/small_supervoxels/stat_*.txt"))
+    codecs, r = readResults(RESULTS)
     N = 0
-    for fname in fnames:
-        if "NO_COMP" in fname or "ZLIB_NONE" in fname:
+    for k, codec in sorted(enumerate(codecs), key=lambda kc: kc[1]):
+        if "NO_COMP" in codec or "ZLIB_NONE" in codec:
             continue
         
-        if only is not None and only not in fname:
+        if only is not None and only not in codec:
             continue
         
-        f = open(fname, 'r')
-        lines = f.readlines()
-        
-        r = csv.DictReader(lines, delimiter=' ')
-        x = []
-        y = []
-        for row in r:
-            x.append( float(row["sizeBytesUncompressed"]) )
-            y.append( float(row[column]) )
-    
-        y = numpy.asarray(y);
-        x = numpy.asarray(x);
+        sel = r["codec"] == k
+        if "kind" in r:
+            # uniform and duplicate sub-blocks (--dedup) were not compressed
+            sel &= r["kind"] == 0
+        if not sel.any():
+            continue
+        x = r["sizeBytesUncompressed"][sel]
+        y = columnOf(r, column)[sel]
+
         assert len(x) == len(y)
         assert x.ndim == y.ndim == 1
         
@@ -83,9 +118,9 @@ def mkPlot(column, ylabel, outfile, yclip=None, only=None):
         c  = colors[ N % len(colors) ]
         marker = numpy.random.choice(markers)
         
-        #plot.errorbar(X/1024**2.0, Y,  YERR, label=fname[len("stat_"):-4], linestyle=ls, color=c, marker=marker, markersize=3, markeredgecolor=c, markerfacecolor=c)
+        #plot.errorbar(X/1024**2.0, Y,  YERR, label=codec, linestyle=ls, color=c, marker=marker, markersize=3, markeredgecolor=c, markerfacecolor=c)
        
-        plot.plot(X/1024**2.0, Y,  label=os.path.basename(fname)[len("stat_"):-4], linestyle=ls, color=c, marker=marker, markersize=3, markeredgecolor=c, markerfacecolor=c)
+        plot.plot(X/1024**2.0, Y,  label=codec, linestyle=ls, color=c, marker=marker, markersize=3, markeredgecolor=c, markerfacecolor=c)
         
         plot.xlabel("uncompressed (MB)")
         plot.ylabel(ylabel)
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vigra/hdf5impex.hxx>
+
+#include "hdf5volume.hxx"
+#include "rawvolume.hxx"
+#include "trace.hxx"
+
+namespace {
+
+const char ATTRIBUTES[] = "attributes.txt";
+const char RAW_DATA[] = "data.raw";
+const char RAW_CODEC[] = "RAW";
+
+typedef BW::Roi<3>::V V;
+
+std::string chunkFile(const std::string& dir, const V& coord) {
+    std::ostringstream s;
+    s << dir << "/" << coord[0] << "/" << coord[1] << "/" << coord[2];
+    return s.str();
+}
+
+void makeDirectory(const std::string& dir) {
+    if(mkdir(dir.c_str(), 0755) != 0 && !(errno == EEXIST && isDirectory(dir))) {
+        throw std::runtime_error("RawVolume: could not create " + dir);
+    }
+}
+
+/**
+ * parse 'codec' into 'compressed' and (if compressed) 'c'
+ */
+void parseCodec(const std::string& codec, bool& compressed, Codec& c) {
+    compressed = codec != RAW_CODEC;
+    if(compressed && !codecFromString(codec, c)) {
+        throw std::runtime_error("RawVolume: unknown codec " + codec);
+    }
+}
+
+/**
+ * read all of 'fd' from offset 0 into 'out'
+ */
+bool readAll(int fd, std::vector<char>& out) {
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        return false;
+    }
+    out.resize(st.st_size);
+    size_t done = 0;
+    while(done < out.size()) {
+        const ssize_t n = pread(fd, out.data() + done, out.size() - done, done);
+        if(n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const char* data, size_t size, off_t offset) {
+    size_t done = 0;
+    while(done < size) {
+        const ssize_t n = pwrite(fd, data + done, size - done, offset + done);
+        if(n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+} /* anonymous namespace */
+
+RawVolume::RawVolume(const std::string& dir, int nthreads)
+    : dir_(dir)
+    , compressed_(false)
+    , fd_(-1)
+    , data_(0)
+    , size_(0)
+    , bytesRead_(0)
+    , pool_(nthreads)
+    , files_(pool_.size())
+    , chunkBuffers_(pool_.size())
+    , codecBuffers_(pool_.size())
+{
+    std::ifstream in((dir + "/" + ATTRIBUTES).c_str());
+    if(!in) {
+        throw std::runtime_error("RawVolume: " + dir + " has no " + ATTRIBUTES);
+    }
+    bool hasShape = false, hasChunkShape = false;
+    std::string key;
+    while(in >> key) {
+        if(key == "shape") {
+            hasShape = bool(in >> shape_[0] >> shape_[1] >> shape_[2]);
+        }
+        else if(key == "chunkShape") {
+            hasChunkShape = bool(in >> chunkShape_[0] >> chunkShape_[1] >> chunkShape_[2]);
+        }
+        else if(key == "codec") {
+            in >> codecName_;
+        }
+        else {
+            throw std::runtime_error("RawVolume: unknown attribute " + key + " in " + dir);
+        }
+    }
+    if(!hasShape || !hasChunkShape || codecName_.empty()) {
+        throw std::runtime_error("RawVolume: incomplete " + dir + "/" + ATTRIBUTES);
+    }
+    parseCodec(codecName_, compressed_, codec_);
+
+    if(chunkShape_ != Shape()) {
+        chunks_ = BW::Blocking<3>(BW::Roi<3>(V(), shape_), chunkShape_);
+        return;
+    }
+
+    // unchunked: map data.raw
+    chunkShape_ = shape_;
+    const std::string file = dir + "/" + RAW_DATA;
+    size_ = prod(shape_)*sizeof(uint32_t);
+    fd_ = ::open(file.c_str(), O_RDONLY);
+    if(fd_ < 0) {
+        throw std::runtime_error("RawVolume: could not open " + file);
+    }
+    struct stat st;
+    if(fstat(fd_, &st) != 0 || size_t(st.st_size) != size_ || size_ == 0) {
+        ::close(fd_);
+        throw std::runtime_error("RawVolume: " + file + " does not match the shape");
+    }
+    void* m = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(m == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("RawVolume: could not map " + file);
+    }
+    data_ = static_cast<const uint32_t*>(m);
+}
+
+RawVolume::~RawVolume() {
+    if(data_) {
+        munmap(const_cast<uint32_t*>(data_), size_);
+        ::close(fd_);
+    }
+}
+
+vigra::MultiArrayView<3, uint32_t> RawVolume::mapped() const {
+    if(!data_) {
+        return vigra::MultiArrayView<3, uint32_t>();
+    }
+    // read-only mapping; the view is only read from
+    return vigra::MultiArrayView<3, uint32_t>(shape_, const_cast<uint32_t*>(data_));
+}
+
+void RawVolume::read(const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t> out) {
+    TRACE_SPAN("raw read");
+    if(data_) {
+        out.copy(mapped().subarray(roi.p, roi.q));
+        bytesRead_ += roi.size()*sizeof(uint32_t);
+        trace::add(trace::BYTES_READ, roi.size()*sizeof(uint32_t));
+        return;
+    }
+    std::lock_guard<std::mutex> lock(readMutex_);
+    // the blocks of 'parts' are the intersections of 'roi' with the chunks
+    const BW::Blocking<3> parts(roi, chunkShape_);
+    for(size_t i=0; i<parts.numBlocks(); ++i) {
+        pool_.submit([&, i]() {
+            const int w = ThreadPool::currentWorker();
+            const BW::Blocking<3>::Pair part = parts[i];
+            readChunk(part.first, part.second, roi.p, out,
+                      files_[w], chunkBuffers_[w], codecBuffers_[w]);
+        });
+    }
+    pool_.wait();
+}
+
+void RawVolume::readChunk(
+    const V& coord,
+    const BW::Roi<3>& part,
+    const V& origin,
+    vigra::MultiArrayView<3, uint32_t>& out,
+    std::vector<char>& file,
+    vigra::ArrayVector<uint32_t>& chunk,
+    CodecBuffers& buffers
+) {
+    const BW::Roi<3> chunkRoi = chunks_.blockRoi(coord);
+    const std::string name = chunkFile(dir_, coord);
+    const int fd = ::open(name.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("RawVolume: could not open " + name);
+    }
+    const bool ok = readAll(fd, file);
+    ::close(fd);
+    if(!ok) {
+        throw std::runtime_error("RawVolume: could not read " + name);
+    }
+    bytesRead_ += file.size();
+    trace::add(trace::BYTES_READ, file.size());
+
+    const uint32_t* voxels = reinterpret_cast<const uint32_t*>(file.data());
+    if(compressed_) {
+        uint64_t filteredSize = 0;
+        if(file.size() < sizeof(filteredSize)) {
+            throw std::runtime_error("RawVolume: truncated chunk " + name);
+        }
+        std::memcpy(&filteredSize, file.data(), sizeof(filteredSize));
+        if(!isFilteredSize(codec_.filter, chunkRoi.size(), filteredSize)) {
+            throw std::runtime_error("RawVolume: corrupt chunk " + name);
+        }
+        if(chunk.size() < chunkRoi.size()) {
+            chunk.resize(chunkRoi.size());
+        }
+        decodeBlock<3, uint32_t>(file.data() + sizeof(filteredSize), file.size() - sizeof(filteredSize),
+                                 filteredSize, codec_, chunkRoi.shape(), 1, buffers, chunk.data());
+        voxels = chunk.data();
+    }
+    else if(file.size() != chunkRoi.size()*sizeof(uint32_t)) {
+        throw std::runtime_error("RawVolume: chunk " + name + " does not match the chunk shape");
+    }
+
+    const vigra::MultiArrayView<3, uint32_t> src(chunkRoi.shape(), const_cast<uint32_t*>(voxels));
+    out.subarray(part.p - origin, part.q - origin)
+       .copy(src.subarray(part.p - chunkRoi.p, part.q - chunkRoi.p));
+}
+
+bool isDirectory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+std::vector<std::string> listVolumes(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    if(!d) {
+        throw std::runtime_error("listVolumes: could not open " + dir);
+    }
+    while(dirent* e = readdir(d)) {
+        const std::string name = e->d_name;
+        struct stat st;
+        if(name != "." && name != ".."
+           && stat((dir + "/" + name + "/" + ATTRIBUTES).c_str(), &st) == 0)
+        {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+void writeRawVolume(
+    Volume& volume,
+    const std::string& dir,
+    const Volume::Shape& chunkShape,
+    const std::string& codec,
+    int nthreads,
+    size_t memoryBudget
+) {
+    using namespace vigra;
+
+    bool compressed = false;
+    Codec c;
+    parseCodec(codec, compressed, c);
+    const bool chunked = chunkShape != Volume::Shape();
+    if(!chunked && compressed) {
+        throw std::runtime_error("writeRawVolume: unchunked volumes must use codec RAW");
+    }
+    const Volume::Shape shape = volume.shape();
+
+    makeDirectory(dir);
+    {
+        std::ofstream attributes((dir + "/" + ATTRIBUTES).c_str(), std::ios::trunc);
+        attributes << "shape " << shape[0] << " " << shape[1] << " " << shape[2] << "\n"
+                   << "chunkShape " << chunkShape[0] << " " << chunkShape[1] << " " << chunkShape[2] << "\n"
+                   << "codec " << codec << "\n";
+        if(!attributes) {
+            throw std::runtime_error("writeRawVolume: could not write " + dir + "/" + ATTRIBUTES);
+        }
+    }
+
+    // data.raw is written in whole z-slabs, which are contiguous in it;
+    // chunks are cut from bricks that are multiples of the chunk shape
+    const Volume::Shape unit = chunked ? chunkShape : Volume::Shape(shape[0], shape[1], 1);
+    const BW::Blocking<3> bricks(BW::Roi<3>(V(), shape),
+                                 brickShape(shape, unit, volume.chunkShape(), memoryBudget));
+
+    int fd = -1;
+    if(!chunked) {
+        const std::string file = dir + "/" + RAW_DATA;
+        fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) {
+            throw std::runtime_error("writeRawVolume: could not open " + file);
+        }
+    }
+
+    ThreadPool pool(nthreads);
+    std::vector<CodecBuffers> codecBuffers(pool.size());
+    std::vector<ArrayVector<uint32_t> > chunkBuffers(pool.size());
+    MultiArray<3, uint32_t> buffer;
+    for(size_t b=0; b<bricks.numBlocks(); ++b) {
+        const BW::Roi<3> brick = bricks[b].second;
+        buffer.reshape(brick.shape());
+        volume.read(brick, buffer);
+
+        if(!chunked) {
+            const off_t offset = off_t(brick.p[2])*shape[0]*shape[1]*sizeof(uint32_t);
+            if(!writeAll(fd, reinterpret_cast<const char*>(buffer.data()),
+                         buffer.size()*sizeof(uint32_t), offset))
+            {
+                ::close(fd);
+                throw std::runtime_error("writeRawVolume: could not write " + dir + "/" + RAW_DATA);
+            }
+            continue;
+        }
+
+        const BW::Blocking<3> chunks(brick, chunkShape);
+        for(size_t i=0; i<chunks.numBlocks(); ++i) {
+            pool.submit([&, i]() {
+                const int w = ThreadPool::currentWorker();
+                const BW::Blocking<3>::Pair chunk = chunks[i];
+                const BW::Roi<3> roi(chunk.second.p - brick.p, chunk.second.q - brick.p);
+                ArrayVector<uint32_t>& voxels = chunkBuffers[w];
+                if(voxels.size() < roi.size()) {
+                    voxels.resize(roi.size());
+                }
+                const MultiArrayView<3, uint32_t> a = extractBlock<uint32_t>(buffer, roi, voxels.data());
+
+                const V& x = chunk.first;
+                makeDirectory(dir + "/" + std::to_string(x[0]));
+                makeDirectory(dir + "/" + std::to_string(x[0]) + "/" + std::to_string(x[1]));
+                const std::string name = chunkFile(dir, x);
+                std::ofstream out(name.c_str(), std::ios::binary | std::ios::trunc);
+                if(compressed) {
+                    const uint64_t filteredSize = encodeBlock(a, c, 1, codecBuffers[w]);
+                    const ArrayVector<char>& payload = codecBuffers[w].compressed;
+                    out.write(reinterpret_cast<const char*>(&filteredSize), sizeof(filteredSize));
+                    out.write(payload.data(), payload.size());
+                }
+                else {
+                    out.write(reinterpret_cast<const char*>(a.data()), a.size()*sizeof(uint32_t));
+                }
+                if(!out) {
+                    throw std::runtime_error("writeRawVolume: could not write " + name);
+                }
+            });
+        }
+        pool.wait();
+    }
+    if(fd >= 0) {
+        ::close(fd);
+    }
+}
+
+void convertTg(
+    const std::string& tgFile,
+    const std::string& dir,
+    const Volume::Shape& chunkShape,
+    const std::string& codec,
+    int nthreads,
+    size_t memoryBudget
+) {
+    using std::cout; using std::endl;
+
+    std::vector<std::string> ls;
+    {
+        vigra::HDF5File file(tgFile, vigra::HDF5File::OpenReadOnly);
+        file.cd("blocks");
+        ls = file.ls();
+    }
+    std::sort(ls.begin(), ls.end());
+
+    makeDirectory(dir);
+    for(const std::string& entry : ls) {
+        // groups are listed with a trailing '/'
+        const std::string name = entry.substr(0, entry.find_last_not_of('/') + 1);
+        HDF5Volume volume(tgFile, "blocks/" + name + "/topological-grid");
+        Stopwatch t;
+        writeRawVolume(volume, dir + "/" + name, chunkShape, codec, nthreads, memoryBudget);
+        cout << "  " << name << " " << volume.shape() << " -> " << dir << "/" << name
+             << " (" << t.elapsedMs()/1000.0 << " s)" << endl;
+    }
+}
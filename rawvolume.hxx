@@ -0,0 +1,126 @@
+#ifndef RAWVOLUME_HXX
+#define RAWVOLUME_HXX
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "blocking.h"
+#include "buffers.hxx"
+#include "compressors.hxx"
+#include "threadpool.hxx"
+#include "volume.hxx"
+
+/*
+ * A volume directory holds one 3-D uint32 volume without HDF5:
+ *
+ *   attributes.txt   "shape X Y Z", "chunkShape X Y Z" and "codec NAME"
+ *                    lines, in vigra axis order
+ *   data.raw         the voxels in vigra order (axis 0 fastest), if the
+ *                    volume is neither chunked nor compressed
+ *   i/j/k            otherwise, one file per chunk with chunk coordinate
+ *                    (i, j, k) (as in N5), holding the chunk's voxels
+ *                    (clipped at the upper border) either uncompressed
+ *                    (codec RAW) or encoded with encodeBlock, preceded by
+ *                    the uint64 size of the filtered data
+ *
+ * A tg file becomes a directory with one volume directory per
+ * blocks/<name>/topological-grid dataset, see convertTg().
+ */
+
+/**
+ * Read-only volume directory.
+ *
+ * Unchunked, uncompressed volumes are memory mapped: mapped() is the
+ * whole volume and read() copies from the mapping, without locking.
+ * Chunks are read with pread and decoded on 'nthreads' threads; several
+ * RawVolumes read in parallel, but chunked reads of one are serialized.
+ */
+class RawVolume : public Volume {
+    public:
+    /**
+     * open the volume directory 'dir'
+     */
+    explicit RawVolume(const std::string& dir, int nthreads = 1);
+    ~RawVolume();
+
+    RawVolume(const RawVolume&) = delete;
+    RawVolume& operator=(const RawVolume&) = delete;
+
+    const Shape& shape() const override { return shape_; }
+    const Shape& chunkShape() const override { return chunkShape_; }
+    bool isChunked() const override { return !data_; }
+
+    /**
+     * may be called concurrently (for disjoint or identical 'out'); calls
+     * on a chunked volume then take turns
+     */
+    void read(const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t> out) override;
+
+    size_t bytesRead() const override { return bytesRead_; }
+
+    vigra::MultiArrayView<3, uint32_t> mapped() const override;
+
+    /** "RAW" or the toString() of the codec of the chunks */
+    const std::string& codecName() const { return codecName_; }
+
+    private:
+    /**
+     * decode chunk 'coord' and copy its part 'part' to 'out', which starts
+     * at 'origin'
+     */
+    void readChunk(const BW::Roi<3>::V& coord, const BW::Roi<3>& part,
+                   const BW::Roi<3>::V& origin, vigra::MultiArrayView<3, uint32_t>& out,
+                   std::vector<char>& file, vigra::ArrayVector<uint32_t>& chunk,
+                   CodecBuffers& buffers);
+
+    std::string dir_;
+    Shape shape_;
+    Shape chunkShape_;
+    std::string codecName_;
+    bool compressed_;
+    Codec codec_;
+    BW::Blocking<3> chunks_;
+    int fd_;
+    const uint32_t* data_;
+    size_t size_;
+    std::atomic<size_t> bytesRead_;
+    ThreadPool pool_;
+    /** held by a chunked read, since pool_.wait() waits for every task */
+    std::mutex readMutex_;
+    /** per worker of pool_ */
+    std::vector<std::vector<char> > files_;
+    std::vector<vigra::ArrayVector<uint32_t> > chunkBuffers_;
+    std::vector<CodecBuffers> codecBuffers_;
+};
+
+/** whether 'path' exists and is a directory */
+bool isDirectory(const std::string& path);
+
+/**
+ * names of the volume directories (those containing attributes.txt) in
+ * 'dir', sorted
+ */
+std::vector<std::string> listVolumes(const std::string& dir);
+
+/**
+ * Copy 'volume' into the new volume directory 'dir', in bricks of at
+ * most 'memoryBudget' bytes. 'chunkShape' all 0 writes data.raw (codec
+ * must be "RAW"), otherwise chunks of that shape, encoded on 'nthreads'
+ * threads with 'codec' ("RAW" or a name accepted by codecFromString).
+ */
+void writeRawVolume(Volume& volume, const std::string& dir,
+                    const Volume::Shape& chunkShape, const std::string& codec,
+                    int nthreads, size_t memoryBudget);
+
+/**
+ * write every blocks/<name>/topological-grid dataset of 'tgFile' to the
+ * volume directory <dir>/<name> with writeRawVolume
+ */
+void convertTg(const std::string& tgFile, const std::string& dir,
+               const Volume::Shape& chunkShape, const std::string& codec,
+               int nthreads, size_t memoryBudget);
+
+#endif /* RAWVOLUME_HXX */
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "resultcache.hxx"
+
+namespace {
+
+const char MAGIC[8] = {'C', 'G', 'P', 'C', 'A', 'C', 'H', '1'};
+
+const uint64_t P1 = 0x9e3779b185ebca87ULL;
+const uint64_t P2 = 0xc2b2ae3d27d4eb4fULL;
+const uint64_t P3 = 0x165667b19e3779f9ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t load64(const unsigned char* p) {
+    uint64_t w;
+    std::memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+inline uint64_t hashRound(uint64_t h, uint64_t w) {
+    return rotl(h + w*P2, 31) * P1;
+}
+
+} /* anonymous namespace */
+
+uint64_t hashBytes(const void* data, size_t bytes, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + bytes;
+
+    // four independent lanes keep several multiplications in flight
+    uint64_t h0 = seed + P1 + P2, h1 = seed + P2, h2 = seed, h3 = seed - P1;
+    for(; end - p >= 32; p += 32) {
+        h0 = hashRound(h0, load64(p));
+        h1 = hashRound(h1, load64(p + 8));
+        h2 = hashRound(h2, load64(p + 16));
+        h3 = hashRound(h3, load64(p + 24));
+    }
+    uint64_t h = rotl(h0, 1) + rotl(h1, 7) + rotl(h2, 12) + rotl(h3, 18);
+    h += bytes;
+    for(; end - p >= 8; p += 8) {
+        h = rotl(h ^ hashRound(0, load64(p)), 27) * P1 + P3;
+    }
+    for(; p < end; ++p) {
+        h = rotl(h ^ (*p * P3), 11) * P1;
+    }
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+ResultCache::ResultCache(const std::string& file, double checkpointSeconds)
+    : checkpointSeconds_(checkpointSeconds)
+    , hits_(0)
+    , misses_(0)
+{
+    load(file);
+}
+
+ResultCache::~ResultCache() {
+    try {
+        checkpoint();
+    }
+    catch(...) {
+    }
+}
+
+void ResultCache::load(const std::string& file) {
+    const size_t entryBytes = sizeof(Key) + sizeof(Values);
+    size_t valid = 0;
+    {
+        std::ifstream in(file.c_str(), std::ios::binary);
+        if(in) {
+            char magic[sizeof(MAGIC)];
+            in.read(magic, sizeof(magic));
+            if(in.gcount() == 0) {
+                // an empty file, e.g. created but never checkpointed
+            }
+            else if(!in || !std::equal(magic, magic + sizeof(MAGIC), MAGIC)) {
+                throw std::runtime_error("ResultCache: " + file + " is not a result cache");
+            }
+            else {
+                valid = sizeof(MAGIC);
+                std::vector<char> entry(entryBytes);
+                while(in.read(entry.data(), entryBytes)) {
+                    Key key;
+                    Values values;
+                    std::memcpy(&key, entry.data(), sizeof(Key));
+                    std::memcpy(&values, entry.data() + sizeof(Key), sizeof(Values));
+                    entries_[key] = values;
+                    valid += entryBytes;
+                }
+            }
+        }
+    }
+    // drop a partially written last entry, so that appended ones line up
+    if(valid > 0 && truncate(file.c_str(), valid) != 0) {
+        throw std::runtime_error("ResultCache: could not truncate " + file);
+    }
+    file_.open(file.c_str(), std::ios::binary | std::ios::app);
+    if(!file_) {
+        throw std::runtime_error("ResultCache: could not open " + file);
+    }
+    if(valid == 0) {
+        file_.write(MAGIC, sizeof(MAGIC));
+        file_.flush();
+    }
+}
+
+uint64_t ResultCache::contentHash(const vigra::MultiArrayView<3, uint32_t>& block) {
+    const uint64_t shape[3] = {uint64_t(block.shape(0)), uint64_t(block.shape(1)), uint64_t(block.shape(2))};
+    uint64_t h = hashBytes(shape, sizeof(shape));
+    if(block.isUnstrided()) {
+        return hashBytes(block.data(), block.size()*sizeof(uint32_t), h);
+    }
+    vigra::MultiArray<3, uint32_t> copy(block);
+    return hashBytes(copy.data(), copy.size()*sizeof(uint32_t), h);
+}
+
+uint64_t ResultCache::paramsHash(const Codec& codec, int codecThreads, const TimingOptions& timing) {
+    std::ostringstream s;
+    s << toString(codec) << " " << codecThreads << " " << timing.warmup << " " << timing.repetitions
+      << " " << timing.minTimeMs << " " << timing.coldCache << " " << timing.cacheFlushBytes;
+    const std::string params = s.str();
+    return hashBytes(params.data(), params.size());
+}
+
+ResultCache::Values ResultCache::toValues(const CompressionStatistics& stat) {
+    const TimingSummary& tc = stat.compressTiming;
+    const TimingSummary& tu = stat.uncompressTiming;
+    const Values values = {
+        {stat.timeCompress, stat.timeUncompress, stat.timeFilter, stat.timeUnfilter,
+         stat.sizeBytesUncompressed, stat.sizeBytesCompressed,
+         tc.min, tc.median, tc.p90, tc.p99, tu.min, tu.median, tu.p90, tu.p99},
+        {tc.runs, tu.runs}
+    };
+    return values;
+}
+
+void ResultCache::fromValues(const Values& values, CompressionStatistics& stat) {
+    const double* v = values.v;
+    stat.timeCompress = v[0];
+    stat.timeUncompress = v[1];
+    stat.timeFilter = v[2];
+    stat.timeUnfilter = v[3];
+    stat.sizeBytesUncompressed = v[4];
+    stat.sizeBytesCompressed = v[5];
+    TimingSummary& tc = stat.compressTiming;
+    TimingSummary& tu = stat.uncompressTiming;
+    tc.min = v[6]; tc.median = v[7]; tc.p90 = v[8]; tc.p99 = v[9];
+    tu.min = v[10]; tu.median = v[11]; tu.p90 = v[12]; tu.p99 = v[13];
+    tc.runs = values.runs[0];
+    tu.runs = values.runs[1];
+}
+
+bool ResultCache::find(const Key& key, CompressionStatistics& stat) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if(it == entries_.end()) {
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+    fromValues(it->second, stat);
+    return true;
+}
+
+void ResultCache::insert(const Key& key, const CompressionStatistics& stat) {
+    std::vector<std::pair<Key, Values> > due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Values values = toValues(stat);
+        // identical sub-blocks measured concurrently are stored once
+        if(!entries_.insert(std::make_pair(key, values)).second) {
+            return;
+        }
+        pending_.push_back(std::make_pair(key, values));
+        if(sinceCheckpoint_.elapsedMs() < checkpointSeconds_*1000.0) {
+            return;
+        }
+        due.swap(pending_);
+        sinceCheckpoint_.restart();
+    }
+    write(due);
+}
+
+void ResultCache::checkpoint() {
+    std::vector<std::pair<Key, Values> > due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        due.swap(pending_);
+        sinceCheckpoint_.restart();
+    }
+    write(due);
+}
+
+void ResultCache::write(const std::vector<std::pair<Key, Values> >& entries) {
+    std::lock_guard<std::mutex> lock(fileMutex_);
+    for(const auto& e : entries) {
+        file_.write(reinterpret_cast<const char*>(&e.first), sizeof(Key));
+        file_.write(reinterpret_cast<const char*>(&e.second), sizeof(Values));
+    }
+    file_.flush();
+    if(!file_) {
+        throw std::runtime_error("ResultCache: write error");
+    }
+}
+
+size_t ResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t ResultCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+size_t ResultCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
@@ -0,0 +1,114 @@
+#ifndef RESULTCACHE_HXX
+#define RESULTCACHE_HXX
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "benchmark.hxx"
+#include "compressors.hxx"
+
+/**
+ * 64 bit hash of 'bytes' bytes (xxHash64-like, several GB/s)
+ */
+uint64_t hashBytes(const void* data, size_t bytes, uint64_t seed = 0);
+
+/**
+ * Persistent cache of codec measurements, keyed by the content of a
+ * sub-block and the parameters it was measured with.
+ *
+ * The file starts with the magic "CGPCACH1", followed by fixed size
+ * entries that are appended as results come in. New entries are written
+ * at most every 'checkpointSeconds' seconds and by checkpoint(), so an
+ * interrupted run loses at most that much work; a partially written last
+ * entry is dropped when the file is opened again. All member functions
+ * may be called concurrently.
+ */
+class ResultCache {
+    public:
+    struct Key {
+        /** hash of the voxels and shape of the sub-block */
+        uint64_t content;
+        /** hash of the codec, codec threads and timing options */
+        uint64_t params;
+
+        bool operator==(const Key& other) const {
+            return content == other.content && params == other.params;
+        }
+    };
+
+    /**
+     * open 'file', loading its entries, or create it
+     */
+    explicit ResultCache(const std::string& file, double checkpointSeconds = 30.0);
+
+    /**
+     * calls checkpoint(), ignoring write errors
+     */
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    static uint64_t contentHash(const vigra::MultiArrayView<3, uint32_t>& block);
+    static uint64_t paramsHash(const Codec& codec, int codecThreads, const TimingOptions& timing);
+
+    /**
+     * fill 'stat' (whose codec is set by the caller) if 'key' is cached
+     */
+    bool find(const Key& key, CompressionStatistics& stat);
+
+    /**
+     * add a measurement; writes all new entries if the last checkpoint is
+     * older than checkpointSeconds
+     */
+    void insert(const Key& key, const CompressionStatistics& stat);
+
+    /**
+     * write all new entries to the file, throws on write errors
+     */
+    void checkpoint();
+
+    /** number of cached measurements */
+    size_t size() const;
+    /** number of successful / failed find()s */
+    size_t hits() const;
+    size_t misses() const;
+
+    private:
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return k.content ^ (k.params * 0x9e3779b97f4a7c15ULL); }
+    };
+
+    /** the measured values of one entry, in file order */
+    struct Values {
+        double v[14];
+        int32_t runs[2];
+    };
+
+    static Values toValues(const CompressionStatistics& stat);
+    static void fromValues(const Values& values, CompressionStatistics& stat);
+
+    void load(const std::string& file);
+    void write(const std::vector<std::pair<Key, Values> >& entries);
+
+    double checkpointSeconds_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, Values, KeyHash> entries_;
+    std::vector<std::pair<Key, Values> > pending_;
+    Stopwatch sinceCheckpoint_;
+    size_t hits_;
+    size_t misses_;
+
+    // held while writing, so that checkpoints do not block find()/insert()
+    std::mutex fileMutex_;
+    std::ofstream file_;
+};
+
+#endif /* RESULTCACHE_HXX */
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "resultsink.hxx"
+#include "trace.hxx"
+
+namespace {
+
+enum ColumnType { UINT32 = 0, UINT64 = 1, FLOAT64 = 2 };
+
+struct Column {
+    const char* name;
+    ColumnType type;
+    uint32_t ResultRecord::* u32;
+    uint64_t ResultRecord::* u64;
+    double ResultRecord::* f64;
+};
+
+Column u32(const char* name, uint32_t ResultRecord::* m) { Column c = {name, UINT32, m, 0, 0}; return c; }
+Column u64(const char* name, uint64_t ResultRecord::* m) { Column c = {name, UINT64, 0, m, 0}; return c; }
+Column f64(const char* name, double ResultRecord::* m)   { Column c = {name, FLOAT64, 0, 0, m}; return c; }
+
+const std::vector<Column> COLUMNS = {
+    u64("block",                 &ResultRecord::block),
+    u32("dataset",               &ResultRecord::dataset),
+    u32("L",                     &ResultRecord::L),
+    u32("codec",                 &ResultRecord::codec),
+    u32("runs",                  &ResultRecord::runs),
+    f64("sizeBytesUncompressed", &ResultRecord::sizeBytesUncompressed),
+    f64("sizeBytesCompressed",   &ResultRecord::sizeBytesCompressed),
+    f64("timeCompress",          &ResultRecord::timeCompress),
+    f64("timeUncompress",        &ResultRecord::timeUncompress),
+    f64("timeFilter",            &ResultRecord::timeFilter),
+    f64("timeUnfilter",          &ResultRecord::timeUnfilter),
+    f64("compressMin",           &ResultRecord::compressMin),
+    f64("compressP90",           &ResultRecord::compressP90),
+    f64("compressP99",           &ResultRecord::compressP99),
+    f64("uncompressMin",         &ResultRecord::uncompressMin),
+    f64("uncompressP90",         &ResultRecord::uncompressP90),
+    f64("uncompressP99",         &ResultRecord::uncompressP99),
+    u32("kind",                  &ResultRecord::kind)
+};
+
+/** length of the fixed size name fields in the header */
+const size_t NAME_LENGTH = 32;
+
+const char MAGIC[8] = {'C', 'G', 'P', 'R', 'E', 'S', '0', '1'};
+
+template<class T>
+void append(std::vector<char>& out, const T& v) {
+    const char* p = reinterpret_cast<const char*>(&v);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+void appendName(std::vector<char>& out, const std::string& name) {
+    char field[NAME_LENGTH] = {0};
+    std::strncpy(field, name.c_str(), NAME_LENGTH-1);
+    out.insert(out.end(), field, field + NAME_LENGTH);
+}
+
+template<class T>
+T read(std::ifstream& in) {
+    T v = T();
+    in.read(reinterpret_cast<char*>(&v), sizeof(T));
+    return v;
+}
+
+std::string readName(std::ifstream& in) {
+    char field[NAME_LENGTH] = {0};
+    in.read(field, NAME_LENGTH);
+    field[NAME_LENGTH-1] = 0;
+    return field;
+}
+
+} /* anonymous namespace */
+
+ResultSink::ResultSink(
+    const std::string& binaryFile,
+    const std::vector<std::string>& codecNames,
+    const std::string& csvFile,
+    size_t batchSize
+)
+    : codecNames_(codecNames)
+    , binary_(binaryFile.c_str(), std::ios::binary | std::ios::trunc)
+    , batchSize_(std::max<size_t>(1, batchSize))
+    , rows_(0)
+    , closed_(false)
+    , queue_(16)
+{
+    if(!binary_) {
+        throw std::runtime_error("ResultSink: could not open " + binaryFile);
+    }
+    if(!csvFile.empty()) {
+        csv_.open(csvFile.c_str(), std::ios::trunc);
+        if(!csv_) {
+            throw std::runtime_error("ResultSink: could not open " + csvFile);
+        }
+    }
+    current_.reserve(batchSize_);
+    writeHeader();
+    thread_ = std::thread(&ResultSink::run, this);
+}
+
+ResultSink::~ResultSink() {
+    try {
+        close();
+    }
+    catch(...) {
+    }
+}
+
+void ResultSink::add(const ResultRecord& r) {
+    Batch full;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(closed_) {
+            throw std::runtime_error("ResultSink: add() after close()");
+        }
+        current_.push_back(r);
+        ++rows_;
+        if(current_.size() < batchSize_) {
+            return;
+        }
+        full.swap(current_);
+        current_.reserve(batchSize_);
+    }
+    queue_.push(std::move(full));
+}
+
+void ResultSink::close() {
+    Batch rest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(closed_) {
+            return;
+        }
+        closed_ = true;
+        rest.swap(current_);
+    }
+    if(!rest.empty()) {
+        queue_.push(std::move(rest));
+    }
+    queue_.close();
+    thread_.join();
+    binary_.close();
+    if(csv_.is_open()) {
+        csv_.close();
+    }
+    if(error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+size_t ResultSink::rows() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rows_;
+}
+
+void ResultSink::run() {
+    trace::setThreadName("result writer");
+    try {
+        Batch batch;
+        while(queue_.pop(batch)) {
+            writeBatch(batch);
+        }
+        binary_.flush();
+        if(!binary_ || (csv_.is_open() && !csv_.flush())) {
+            throw std::runtime_error("ResultSink: write error");
+        }
+    }
+    catch(...) {
+        error_ = std::current_exception();
+        // keep draining, so that add() never blocks on a dead writer
+        Batch batch;
+        while(queue_.pop(batch)) {}
+    }
+}
+
+void ResultSink::writeHeader() {
+    std::vector<char> header(MAGIC, MAGIC + sizeof(MAGIC));
+    append<uint32_t>(header, codecNames_.size());
+    for(const std::string& name : codecNames_) {
+        appendName(header, name);
+    }
+    append<uint32_t>(header, COLUMNS.size());
+    for(const Column& c : COLUMNS) {
+        appendName(header, c.name);
+        append<uint32_t>(header, c.type);
+    }
+    binary_.write(header.data(), header.size());
+
+    if(csv_.is_open()) {
+        std::string line;
+        for(const Column& c : COLUMNS) {
+            if(!line.empty()) { line += " "; }
+            line += c.name;
+        }
+        line += "\n";
+        csv_.write(line.data(), line.size());
+    }
+}
+
+void ResultSink::writeBatch(const Batch& batch) {
+    TRACE_SPAN("write results");
+    std::vector<char> out;
+    out.reserve(sizeof(uint64_t) + batch.size()*sizeof(ResultRecord));
+    append<uint64_t>(out, batch.size());
+    for(const Column& c : COLUMNS) {
+        for(const ResultRecord& r : batch) {
+            switch(c.type) {
+                case UINT32:  append(out, r.*c.u32); break;
+                case UINT64:  append(out, r.*c.u64); break;
+                case FLOAT64: append(out, r.*c.f64); break;
+            }
+        }
+    }
+    binary_.write(out.data(), out.size());
+    trace::add(trace::BYTES_WRITTEN, out.size());
+
+    if(!csv_.is_open()) {
+        return;
+    }
+    std::string text;
+    text.reserve(batch.size()*160);
+    char field[64];
+    for(const ResultRecord& r : batch) {
+        for(size_t k=0; k<COLUMNS.size(); ++k) {
+            const Column& c = COLUMNS[k];
+            if(c.u32 == &ResultRecord::codec) {
+                text += r.codec < codecNames_.size() ? codecNames_[r.codec] : std::string("?");
+            }
+            else {
+                switch(c.type) {
+                    case UINT32:  std::snprintf(field, sizeof(field), "%u", unsigned(r.*c.u32)); break;
+                    case UINT64:  std::snprintf(field, sizeof(field), "%llu", (unsigned long long)(r.*c.u64)); break;
+                    case FLOAT64: std::snprintf(field, sizeof(field), "%.9g", r.*c.f64); break;
+                }
+                text += field;
+            }
+            text += k+1 < COLUMNS.size() ? ' ' : '\n';
+        }
+    }
+    csv_.write(text.data(), text.size());
+}
+
+void readResults(
+    const std::string& binaryFile,
+    std::vector<std::string>& codecNames,
+    std::vector<ResultRecord>& records
+) {
+    std::ifstream in(binaryFile.c_str(), std::ios::binary);
+    if(!in) {
+        throw std::runtime_error("readResults: could not open " + binaryFile);
+    }
+    char magic[sizeof(MAGIC)];
+    in.read(magic, sizeof(magic));
+    if(!in || !std::equal(magic, magic + sizeof(MAGIC), MAGIC)) {
+        throw std::runtime_error("readResults: " + binaryFile + " is not a result file");
+    }
+    codecNames.resize(read<uint32_t>(in));
+    for(std::string& name : codecNames) {
+        name = readName(in);
+    }
+    const uint32_t numColumns = read<uint32_t>(in);
+    bool sameColumns = numColumns == COLUMNS.size();
+    for(uint32_t k=0; k<numColumns && in; ++k) {
+        const std::string name = readName(in);
+        const uint32_t type = read<uint32_t>(in);
+        sameColumns = sameColumns && name == COLUMNS[k].name && type == uint32_t(COLUMNS[k].type);
+    }
+    if(!in || !sameColumns) {
+        throw std::runtime_error("readResults: unexpected columns in " + binaryFile);
+    }
+
+    records.clear();
+    while(true) {
+        const uint64_t rows = read<uint64_t>(in);
+        if(in.eof()) {
+            break;
+        }
+        const size_t first = records.size();
+        records.resize(first + rows);
+        for(const Column& c : COLUMNS) {
+            for(size_t i=first; i<records.size(); ++i) {
+                ResultRecord& r = records[i];
+                switch(c.type) {
+                    case UINT32:  r.*c.u32 = read<uint32_t>(in); break;
+                    case UINT64:  r.*c.u64 = read<uint64_t>(in); break;
+                    case FLOAT64: r.*c.f64 = read<double>(in); break;
+                }
+            }
+        }
+        if(!in) {
+            throw std::runtime_error("readResults: " + binaryFile + " is truncated");
+        }
+    }
+}
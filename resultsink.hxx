@@ -0,0 +1,128 @@
+#ifndef RESULTSINK_HXX
+#define RESULTSINK_HXX
+
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pipeline.hxx"
+
+/**
+ * one measurement: a sub-block compressed with one codec
+ */
+struct ResultRecord {
+    ResultRecord()
+      : block(0), dataset(0), L(0), codec(0), runs(0)
+      , sizeBytesUncompressed(0), sizeBytesCompressed(0)
+      , timeCompress(0), timeUncompress(0), timeFilter(0), timeUnfilter(0)
+      , compressMin(0), compressP90(0), compressP99(0)
+      , uncompressMin(0), uncompressP90(0), uncompressP99(0)
+      , kind(0)
+      {}
+
+    /** linear index of the sub-block in the dataset's blocking for this L */
+    uint64_t block;
+    /** index of the dataset in the (sorted) tg file */
+    uint32_t dataset;
+    uint32_t L;
+    /** index into the codec names given to the ResultSink */
+    uint32_t codec;
+    uint32_t runs;
+    double sizeBytesUncompressed;
+    double sizeBytesCompressed;
+    /** median run times in ms */
+    double timeCompress;
+    double timeUncompress;
+    double timeFilter;
+    double timeUnfilter;
+    /** run time percentiles in ms */
+    double compressMin;
+    double compressP90;
+    double compressP99;
+    double uncompressMin;
+    double uncompressP90;
+    double uncompressP99;
+    /**
+     * a BlockKind: 0 for sub-blocks measured with the codec, 1 and 2 for
+     * uniform and duplicate ones, whose sizes are those of their constant
+     * encoding and whose times are 0
+     */
+    uint32_t kind;
+};
+
+/**
+ * Collects ResultRecords and writes them on a background thread.
+ *
+ * The binary file starts with a header (magic "CGPRES01", the codec names
+ * and the column names and types) followed by row groups: the number of
+ * rows (uint64) and then every column of these rows contiguously. Column
+ * types are 0 = uint32, 1 = uint64, 2 = float64, all little endian.
+ *
+ * Optionally, the same rows are exported as a space separated text file
+ * with a header line. Both files are written in large chunks; add() only
+ * appends to an in-memory batch and hands full batches to the writer.
+ */
+class ResultSink {
+    public:
+    /**
+     * 'csvFile' may be empty; 'batchSize' is the number of rows per row group
+     */
+    ResultSink(const std::string& binaryFile,
+               const std::vector<std::string>& codecNames,
+               const std::string& csvFile = std::string(),
+               size_t batchSize = 1 << 16);
+
+    /**
+     * calls close()
+     */
+    ~ResultSink();
+
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+    void add(const ResultRecord& r);
+
+    /**
+     * write the pending rows and wait for the writer; rethrows write
+     * errors. Further calls do nothing.
+     */
+    void close();
+
+    /** number of rows added so far */
+    size_t rows() const;
+
+    private:
+    typedef std::vector<ResultRecord> Batch;
+
+    void run();
+    void writeHeader();
+    void writeBatch(const Batch& batch);
+
+    std::vector<std::string> codecNames_;
+    std::ofstream binary_;
+    std::ofstream csv_;
+    size_t batchSize_;
+
+    mutable std::mutex mutex_;
+    Batch current_;
+    size_t rows_;
+    bool closed_;
+
+    BoundedQueue<Batch> queue_;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+/**
+ * read a file written by ResultSink: its codec names and all rows, in
+ * file order; throws if the file is not a result file of this version
+ */
+void readResults(const std::string& binaryFile,
+                 std::vector<std::string>& codecNames,
+                 std::vector<ResultRecord>& records);
+
+#endif /* RESULTSINK_HXX */
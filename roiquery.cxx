@@ -0,0 +1,80 @@
+#include "roiquery.hxx"
+
+RoiQuery::RoiQuery(const BlockStore& store, int nthreads, BlockCache* cache)
+    : store_(store)
+    , cache_(cache)
+    , cores_(store.blocking().roi(), store.blocking().blockShape())
+    , pool_(nthreads)
+    , codecBuffers_(pool_.size())
+{}
+
+std::vector<size_t> RoiQuery::blocksIntersecting(const BW::Roi<3>& roi) const {
+    typedef BW::Blocking<3>::V V;
+
+    std::vector<size_t> blocks;
+    BW::Roi<3> r;
+    if(!roi.intersect(cores_.roi(), r)) {
+        return blocks;
+    }
+    const V b = cores_.blockContaining(r.p);
+    const V e = cores_.blockContaining(r.q - V(1,1,1)) + V(1,1,1);
+    V x;
+    for(x[0]=b[0]; x[0]<e[0]; ++x[0]) {
+        for(x[1]=b[1]; x[1]<e[1]; ++x[1]) {
+            for(x[2]=b[2]; x[2]<e[2]; ++x[2]) {
+                blocks.push_back(cores_.blockIndex(x));
+            }
+        }
+    }
+    return blocks;
+}
+
+void RoiQuery::readBlock(
+    size_t i,
+    const BW::Roi<3>& roi,
+    vigra::MultiArrayView<3, uint32_t>& out,
+    CodecBuffers& buffers
+) {
+    using namespace vigra;
+
+    const BW::Blocking<3>::Pair b = store_.blocking()[i];
+    const BW::Roi<3>& blockRoi = b.second;
+    BW::Roi<3> part;
+    cores_[i].second.intersect(roi, part);
+
+    // keeps the decompressed block alive until it has been copied
+    std::shared_ptr<const ArrayVector<uint32_t> > buffer;
+    if(cache_) {
+        buffer = cache_->get(BlockKey(b.first, store_.entry(i).codec()),
+            [&](BlockCache::Buffer& dest) {
+                dest.resize(blockRoi.size());
+                store_.read(i, dest.data(), buffers);
+            });
+    }
+    else {
+        BlockBufferPool::Handle pooled = blockBuffers_.acquire(blockRoi.size());
+        store_.read(i, pooled->data(), buffers);
+        buffer = pooled;
+    }
+    const MultiArrayView<3, uint32_t> block(blockRoi.shape(), const_cast<uint32_t*>(buffer->data()));
+    out.subarray(part.p - roi.p, part.q - roi.p).copy(
+        block.subarray(part.p - blockRoi.p, part.q - blockRoi.p));
+}
+
+size_t RoiQuery::read(const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t> out) {
+    const std::vector<size_t> blocks = blocksIntersecting(roi);
+    if(blocks.size() == 1 || pool_.size() == 1) {
+        for(size_t i : blocks) {
+            readBlock(i, roi, out, callerBuffers_);
+        }
+        return blocks.size();
+    }
+    // the blocks write to disjoint parts of 'out'
+    for(size_t i : blocks) {
+        pool_.submit([this, i, &roi, &out]() {
+            readBlock(i, roi, out, codecBuffers_[ThreadPool::currentWorker()]);
+        });
+    }
+    pool_.wait();
+    return blocks.size();
+}
@@ -0,0 +1,60 @@
+#ifndef ROIQUERY_HXX
+#define ROIQUERY_HXX
+
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "blockcache.hxx"
+#include "blocking.h"
+#include "blockstore.hxx"
+#include "buffers.hxx"
+#include "threadpool.hxx"
+
+/**
+ * Answers region of interest queries over a BlockStore, decompressing
+ * only the blocks the region touches.
+ *
+ * Blocks are decompressed on a thread pool when a query touches several
+ * of them; every block fills its part of the output directly. Only the
+ * (non-overlapping) core of each block is used, so with overlapping
+ * blocks every voxel is still written exactly once.
+ *
+ * With a BlockCache, decompressed blocks are looked up in (and added to)
+ * the cache first; the cache may be shared between several queries.
+ *
+ * Not thread-safe; one query runs at a time.
+ */
+class RoiQuery {
+    public:
+    RoiQuery(const BlockStore& store, int nthreads = 1, BlockCache* cache = 0);
+
+    /**
+     * linear indices of the blocks whose core intersects 'roi'
+     */
+    std::vector<size_t> blocksIntersecting(const BW::Roi<3>& roi) const;
+
+    /**
+     * fill 'out' (of shape roi.shape()) with the voxels of 'roi', which
+     * must lie inside store.blocking().roi()
+     *
+     * returns: the number of blocks decompressed
+     */
+    size_t read(const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t> out);
+
+    private:
+    /** decompress block 'i' and copy its part of 'roi' into 'out' */
+    void readBlock(size_t i, const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t>& out,
+                   CodecBuffers& buffers);
+
+    const BlockStore& store_;
+    BlockCache* cache_;
+    /** the blocking of the store without overlap */
+    BW::Blocking<3> cores_;
+    ThreadPool pool_;
+    std::vector<CodecBuffers> codecBuffers_;
+    CodecBuffers callerBuffers_;
+    BlockBufferPool blockBuffers_;
+};
+
+#endif /* ROIQUERY_HXX */
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include "shapetuner.hxx"
+#include "blocking.h"
+#include "blocksampler.hxx"
+#include "storestatistics.hxx"
+
+namespace {
+
+typedef vigra::MultiArrayShape<3>::type Shape;
+
+/**
+ * all block shape / halo combinations allowed by 'options' for a volume
+ * of shape 'volume'; edges longer than the volume are clipped to it
+ */
+std::vector<TunerResult> candidates(const Shape& volume, const TunerOptions& options) {
+    std::vector<Shape> shapes;
+    for(int ex : options.edges) {
+        for(int ey : options.edges) {
+            for(int ez : options.edges) {
+                const Shape s(std::min<vigra::MultiArrayIndex>(ex, volume[0]),
+                              std::min<vigra::MultiArrayIndex>(ey, volume[1]),
+                              std::min<vigra::MultiArrayIndex>(ez, volume[2]));
+                const vigra::MultiArrayIndex shortest = std::min(s[0], std::min(s[1], s[2]));
+                const vigra::MultiArrayIndex longest = std::max(s[0], std::max(s[1], s[2]));
+                const size_t voxels = prod(s);
+                if(shortest < 1 || longest > shortest*options.maxAnisotropy) {
+                    continue;
+                }
+                if(voxels > options.maxBlockVoxels ||
+                   voxels < std::min<size_t>(options.minBlockVoxels, prod(volume))) {
+                    continue;
+                }
+                // clipping may map several combinations to the same shape
+                if(std::find(shapes.begin(), shapes.end(), s) == shapes.end()) {
+                    shapes.push_back(s);
+                }
+            }
+        }
+    }
+    std::vector<TunerResult> results;
+    for(int halo : options.halos) {
+        for(const Shape& s : shapes) {
+            TunerResult r;
+            r.blockShape = s;
+            r.halo = std::max(0, halo);
+            results.push_back(r);
+        }
+    }
+    return results;
+}
+
+/**
+ * measure 'r' on (at most) 'blocks' blocks of the volume of 'sampler';
+ * every call with the same shape uses the same blocks
+ */
+void measureCandidate(BlockSampler& sampler, const Shape& volume, TunerResult& r, size_t blocks) {
+    const BW::Roi<3> roi({0,0,0}, volume);
+    const BW::Blocking<3> blocking(roi, r.blockShape, Shape(r.halo, r.halo, r.halo));
+    const BW::Blocking<3> cores(roi, r.blockShape);
+
+    const std::vector<size_t> order = BlockSampler::sample(blocking.numBlocks(), blocks);
+    const size_t n = order.size();
+
+    std::vector<double> compressed(n), coreBytes(n), timeCompress(n), timeUncompress(n);
+    sampler.forEach(n, [&](size_t k) {
+        const size_t i = order[k];
+        const CompressionStatistics stat = sampler.measure(blocking[i].second);
+        compressed[k] = stat.sizeBytesCompressed;
+        coreBytes[k] = cores[i].second.size()*sizeof(uint32_t);
+        timeCompress[k] = stat.timeCompress;
+        timeUncompress[k] = stat.timeUncompress;
+    });
+
+    const double core = std::accumulate(coreBytes.begin(), coreBytes.end(), 0.0);
+    r.ratio = core > 0 ? std::accumulate(compressed.begin(), compressed.end(), 0.0) / core : 0.0;
+    r.compressMBs = MBPerS(core, std::accumulate(timeCompress.begin(), timeCompress.end(), 0.0));
+    r.uncompressMBs = MBPerS(core, std::accumulate(timeUncompress.begin(), timeUncompress.end(), 0.0));
+    r.blocks = n;
+}
+
+/**
+ * for each candidate that is not pruned, whether another one with the
+ * same halo (and not pruned either) dominates it by 'margin'
+ */
+std::vector<bool> dominated(const std::vector<TunerResult>& results, double margin) {
+    std::vector<bool> d(results.size(), false);
+    for(size_t i=0; i<results.size(); ++i) {
+        if(results[i].pruned) {
+            continue;
+        }
+        for(size_t j=0; j<results.size(); ++j) {
+            if(j != i && !results[j].pruned && results[j].halo == results[i].halo &&
+               dominates(results[j], results[i], margin)) {
+                d[i] = true;
+                break;
+            }
+        }
+    }
+    return d;
+}
+
+} /* anonymous namespace */
+
+bool dominates(const TunerResult& a, const TunerResult& b, double margin) {
+    if(margin > 0.0) {
+        return a.ratio*(1.0+margin) <= b.ratio
+            && a.compressMBs >= b.compressMBs*(1.0+margin)
+            && a.uncompressMBs >= b.uncompressMBs*(1.0+margin);
+    }
+    const bool noWorse = a.ratio <= b.ratio
+                      && a.compressMBs >= b.compressMBs
+                      && a.uncompressMBs >= b.uncompressMBs;
+    const bool better = a.ratio < b.ratio
+                     || a.compressMBs > b.compressMBs
+                     || a.uncompressMBs > b.uncompressMBs;
+    return noWorse && better;
+}
+
+std::vector<TunerResult> tuneBlockShape(const vigra::MultiArrayView<3, uint32_t>& data,
+                                        const TunerOptions& options) {
+    using std::cout; using std::endl; using std::flush;
+
+    std::vector<TunerResult> results = candidates(data.shape(), options);
+    BlockSampler sampler(data, options.codec, options.nthreads, options.codecThreads, options.timing);
+
+    // first round on a few blocks, then prune what is clearly worse
+    const size_t first = std::max<size_t>(1, options.sampleBlocks/4);
+    for(size_t i=0; i<results.size(); ++i) {
+        cout << "\r  round 1: candidate " << i+1 << "/" << results.size() << flush;
+        measureCandidate(sampler, data.shape(), results[i], first);
+    }
+    const std::vector<bool> clearlyWorse = dominated(results, options.pruneMargin);
+    for(size_t i=0; i<results.size(); ++i) {
+        results[i].pruned = clearlyWorse[i];
+    }
+    const size_t survivors = std::count_if(results.begin(), results.end(),
+                                           [](const TunerResult& r) { return !r.pruned; });
+    cout << endl << "  pruned " << results.size() - survivors << " of " << results.size()
+         << " candidates" << endl;
+
+    size_t k = 0;
+    for(TunerResult& r : results) {
+        if(r.pruned) {
+            continue;
+        }
+        cout << "\r  round 2: candidate " << ++k << "/" << survivors << flush;
+        measureCandidate(sampler, data.shape(), r, options.sampleBlocks);
+    }
+    cout << endl;
+    const std::vector<bool> worse = dominated(results, 0.0);
+    for(size_t i=0; i<results.size(); ++i) {
+        results[i].pareto = !results[i].pruned && !worse[i];
+    }
+    return results;
+}
+
+void tunerStatistics(const std::string& tgFile, const TunerOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl; using std::setw;
+
+    MultiArray<3, uint32_t> data;
+    std::string name;
+    readFirstDataset(tgFile, data, name);
+    cout << "* tuning block shape and halo for " << name << " " << data.shape()
+         << " with " << toString(options.codec) << endl;
+
+    std::vector<TunerResult> results = tuneBlockShape(data, options);
+    std::sort(results.begin(), results.end(), [](const TunerResult& a, const TunerResult& b) {
+        return a.halo < b.halo || (a.halo == b.halo && a.ratio < b.ratio);
+    });
+
+    std::ofstream file("tuner.txt", std::ios::trunc);
+    file /* 0 */ << "sx "
+         /* 1 */ << "sy "
+         /* 2 */ << "sz "
+         /* 3 */ << "halo "
+         /* 4 */ << "blocks "
+         /* 5 */ << "compessionRatio "
+         /* 6 */ << "MBPerS_compress "
+         /* 7 */ << "MBPerS_uncompress "
+         /* 8 */ << "pruned "
+         /* 9 */ << "pareto"
+                 << endl;
+    int halo = -1;
+    for(const TunerResult& r : results) {
+        file /* 0 */ << r.blockShape[0] << " "
+             /* 1 */ << r.blockShape[1] << " "
+             /* 2 */ << r.blockShape[2] << " "
+             /* 3 */ << r.halo << " "
+             /* 4 */ << r.blocks << " "
+             /* 5 */ << r.ratio << " "
+             /* 6 */ << r.compressMBs << " "
+             /* 7 */ << r.uncompressMBs << " "
+             /* 8 */ << r.pruned << " "
+             /* 9 */ << r.pareto
+                     << endl;
+        if(!r.pareto) {
+            continue;
+        }
+        if(r.halo != halo) {
+            halo = r.halo;
+            cout << "  Pareto front for halo " << halo
+                 << " (shape: ratio, compress MB/s, uncompress MB/s):" << endl;
+        }
+        cout << "    " << setw(16) << r.blockShape << ": " << setw(10) << r.ratio << " "
+             << setw(10) << r.compressMBs << " " << setw(10) << r.uncompressMBs << endl;
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef SHAPETUNER_HXX
+#define SHAPETUNER_HXX
+
+#include <string>
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "benchmark.hxx"
+#include "compressors.hxx"
+
+struct TunerOptions {
+    TunerOptions()
+      : edges({16, 32, 64, 128, 256})
+      , halos({0, 1, 2, 4})
+      , maxAnisotropy(8)
+      , minBlockVoxels(size_t(16)*16*16)
+      , maxBlockVoxels(size_t(256)*256*256)
+      , codec(vigra::LZ4)
+      , nthreads(1)
+      , codecThreads(1)
+      , sampleBlocks(64)
+      , pruneMargin(0.1)
+      {}
+
+    /** edge lengths tried along each axis independently */
+    std::vector<int> edges;
+    /** overlaps (halo widths) tried, the same along every axis */
+    std::vector<int> halos;
+    /** largest ratio of the longest to the shortest block edge */
+    int maxAnisotropy;
+    size_t minBlockVoxels;
+    size_t maxBlockVoxels;
+    /** codec every candidate is measured with */
+    Codec codec;
+    /** number of worker threads compressing sampled blocks */
+    int nthreads;
+    /** number of threads each codec may use internally */
+    int codecThreads;
+    TimingOptions timing;
+    /**
+     * number of randomly chosen blocks measured per candidate; the first
+     * round (before pruning) measures a quarter of them
+     */
+    size_t sampleBlocks;
+    /**
+     * after the first round, drop candidates that another one with the
+     * same halo beats by at least this fraction in all three objectives
+     */
+    double pruneMargin;
+};
+
+/**
+ * one block shape / halo combination and what it costs; sizes and
+ * throughputs are relative to the core (non-overlapping) voxels, so the
+ * redundant halo voxels count as overhead
+ */
+struct TunerResult {
+    TunerResult()
+      : halo(0)
+      , ratio(0)
+      , compressMBs(0)
+      , uncompressMBs(0)
+      , blocks(0)
+      , pruned(false)
+      , pareto(false)
+      {}
+
+    vigra::MultiArrayShape<3>::type blockShape;
+    int halo;
+    /** compressed bytes per uncompressed core byte */
+    double ratio;
+    /** core MB per second of single-threaded compression */
+    double compressMBs;
+    /** core MB per second of single-threaded decompression */
+    double uncompressMBs;
+    /** number of blocks measured */
+    size_t blocks;
+    /** dropped after the first round */
+    bool pruned;
+    /** on the Pareto front of its halo */
+    bool pareto;
+};
+
+/**
+ * Search block shapes (all combinations of options.edges within the
+ * anisotropy and size limits) and halos for compressing 'data' with
+ * options.codec. Every candidate is first measured on a few random blocks;
+ * clearly dominated ones are pruned and the rest are measured on
+ * options.sampleBlocks blocks. Marks the Pareto front of (ratio, compress
+ * and uncompress throughput) per halo width.
+ */
+std::vector<TunerResult> tuneBlockShape(const vigra::MultiArrayView<3, uint32_t>& data,
+                                        const TunerOptions& options);
+
+/**
+ * Pareto dominance for margin 0: 'a' is at least as good as 'b' in every
+ * objective and better in at least one. For margin > 0, 'a' must be better
+ * by at least that fraction in every objective.
+ */
+bool dominates(const TunerResult& a, const TunerResult& b, double margin = 0.0);
+
+/**
+ * run tuneBlockShape on the first topological grid dataset of 'tgFile';
+ * prints the Pareto front per halo and writes all candidates to tuner.txt
+ */
+void tunerStatistics(const std::string& tgFile, const TunerOptions& options);
+
+#endif /* SHAPETUNER_HXX */
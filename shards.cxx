@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shards.hxx"
+#include "resultsink.hxx"
+
+namespace {
+
+/** options of the parent that are not passed on to the shard processes */
+const std::vector<std::string> PARENT_OPTIONS = {"--processes", "--shard", "--results", "--csv"};
+
+/** options naming files that every shard process needs its own one of */
+const std::vector<std::string> PER_SHARD_OPTIONS = {"--chromeTrace", "--cache"};
+
+/**
+ * whether 'arg' is option 'name' given as "--name value" (returns 1) or
+ * "--name=value" (returns 2), 0 otherwise
+ */
+int matchOption(const std::string& arg, const std::string& name) {
+    if(arg == name) {
+        return 1;
+    }
+    if(arg.compare(0, name.size()+1, name + "=") == 0) {
+        return 2;
+    }
+    return 0;
+}
+
+std::vector<std::string> shardArguments(const std::vector<std::string>& args,
+                                        const Shard& shard,
+                                        const std::string& resultFile) {
+    std::vector<std::string> out;
+    for(size_t i=0; i<args.size(); ++i) {
+        bool dropped = false;
+        for(const std::string& name : PARENT_OPTIONS) {
+            const int m = matchOption(args[i], name);
+            if(m) {
+                i += m == 1 ? 1 : 0;
+                dropped = true;
+                break;
+            }
+        }
+        for(const std::string& name : PER_SHARD_OPTIONS) {
+            const int m = matchOption(args[i], name);
+            if(m) {
+                const std::string file = m == 1 ? (i+1 < args.size() ? args[++i] : std::string())
+                                                : args[i].substr(name.size()+1);
+                out.push_back(name);
+                out.push_back(shardFile(file, shard));
+                dropped = true;
+                break;
+            }
+        }
+        if(!dropped) {
+            out.push_back(args[i]);
+        }
+    }
+    out.push_back("--shard");
+    out.push_back(toString(shard));
+    out.push_back("--results");
+    out.push_back(shardFile(resultFile, shard));
+    return out;
+}
+
+/**
+ * start this program with 'args', its output redirected to 'logFile'
+ */
+pid_t launch(const std::vector<std::string>& args, const std::string& logFile) {
+    std::vector<char*> argv;
+    std::string self = "/proc/self/exe";
+    argv.push_back(&self[0]);
+    std::vector<std::string> copy(args);
+    for(std::string& a : copy) {
+        argv.push_back(&a[0]);
+    }
+    argv.push_back(0);
+
+    const pid_t pid = fork();
+    if(pid < 0) {
+        throw std::runtime_error(std::string("runShards: fork failed: ") + std::strerror(errno));
+    }
+    if(pid == 0) {
+        const int fd = open(logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+} /* anonymous namespace */
+
+bool shardFromString(const std::string& s, Shard& shard) {
+    std::istringstream in(s);
+    Shard r;
+    char slash = 0;
+    if(!(in >> r.index >> slash >> r.count) || slash != '/' || !in.eof()) {
+        return false;
+    }
+    if(r.count < 1 || r.index < 0 || r.index >= r.count) {
+        return false;
+    }
+    shard = r;
+    return true;
+}
+
+std::string toString(const Shard& shard) {
+    return std::to_string(shard.index) + "/" + std::to_string(shard.count);
+}
+
+std::string shardFile(const std::string& file, const Shard& shard) {
+    return file + "." + std::to_string(shard.index) + "of" + std::to_string(shard.count);
+}
+
+std::vector<std::string> runShards(
+    const std::vector<std::string>& args,
+    int processes,
+    const std::string& resultFile
+) {
+    using std::cout; using std::endl;
+
+    processes = std::max(1, processes);
+    std::vector<std::string> files;
+    std::vector<pid_t> pids;
+    for(int i=0; i<processes; ++i) {
+        Shard shard;
+        shard.index = i;
+        shard.count = processes;
+        files.push_back(shardFile(resultFile, shard));
+        pids.push_back(launch(shardArguments(args, shard, resultFile), files.back() + ".log"));
+    }
+    cout << "* started " << processes << " shard processes, output in " << files.front()
+         << ".log etc." << endl;
+
+    std::string failed;
+    for(int i=0; i<processes; ++i) {
+        int status = 0;
+        if(waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed += (failed.empty() ? "" : ", ") + std::to_string(i);
+            continue;
+        }
+        cout << "  shard " << i << "/" << processes << " done" << endl;
+    }
+    if(!failed.empty()) {
+        throw std::runtime_error("runShards: shard(s) " + failed + " failed, see their .log files");
+    }
+    return files;
+}
+
+void mergeResults(
+    const std::vector<std::string>& inputs,
+    const std::string& resultFile,
+    const std::string& csvFile
+) {
+    using std::cout; using std::endl;
+
+    if(inputs.empty()) {
+        throw std::runtime_error("mergeResults: no input files");
+    }
+    std::vector<std::string> codecNames;
+    std::vector<ResultRecord> all;
+    for(const std::string& input : inputs) {
+        std::vector<std::string> names;
+        std::vector<ResultRecord> records;
+        readResults(input, names, records);
+        if(codecNames.empty()) {
+            codecNames = names;
+        }
+        else if(names != codecNames) {
+            throw std::runtime_error("mergeResults: " + input + " was measured with other codecs");
+        }
+        all.insert(all.end(), records.begin(), records.end());
+    }
+
+    auto key = [](const ResultRecord& r) {
+        return std::make_tuple(r.dataset, r.L, r.block, r.codec);
+    };
+    std::sort(all.begin(), all.end(), [&key](const ResultRecord& a, const ResultRecord& b) {
+        return key(a) < key(b);
+    });
+    for(size_t i=1; i<all.size(); ++i) {
+        if(key(all[i-1]) == key(all[i])) {
+            throw std::runtime_error("mergeResults: block " + std::to_string(all[i].block)
+                                     + " of dataset " + std::to_string(all[i].dataset)
+                                     + " with L=" + std::to_string(all[i].L)
+                                     + " appears in several inputs");
+        }
+    }
+
+    ResultSink sink(resultFile, codecNames, csvFile);
+    for(const ResultRecord& r : all) {
+        sink.add(r);
+    }
+    sink.close();
+    cout << "* merged " << all.size() << " results of " << inputs.size() << " files into "
+         << resultFile << (csvFile.empty() ? std::string() : " and " + csvFile) << endl;
+}
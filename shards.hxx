@@ -0,0 +1,64 @@
+#ifndef SHARDS_HXX
+#define SHARDS_HXX
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * part 'index' of a run split into 'count' parts; every work unit belongs
+ * to exactly one part
+ */
+struct Shard {
+    Shard()
+      : index(0)
+      , count(1)
+      {}
+
+    int index;
+    int count;
+
+    bool owns(uint64_t unit) const {
+        return int(unit % count) == index;
+    }
+};
+
+/**
+ * parse "i/N" with 0 <= i < N, return false if 's' is not of that form
+ */
+bool shardFromString(const std::string& s, Shard& shard);
+
+std::string toString(const Shard& shard);
+
+/**
+ * name of the result file of 'shard' for the merged result file 'file',
+ * e.g. stat.bin.3of8
+ */
+std::string shardFile(const std::string& file, const Shard& shard);
+
+/**
+ * Run this program once per shard in 'processes' local processes, with
+ * the command line 'args' (without the program name) extended by
+ * --shard i/N and --results <shardFile(resultFile)>. Options the parent
+ * handles itself (--processes, --shard, --results, --csv) are dropped
+ * from 'args', and --chromeTrace and --cache get per-shard file names.
+ * The output of each process goes to its result file name plus ".log".
+ * Waits for all processes and throws if one of them fails.
+ *
+ * returns: the result files of all shards
+ */
+std::vector<std::string> runShards(const std::vector<std::string>& args,
+                                   int processes,
+                                   const std::string& resultFile);
+
+/**
+ * Combine the result files of several shards (which must list the same
+ * codecs) into one result file (and optionally a text export), ordered
+ * by dataset, L, sub-block and codec. Throws if two inputs contain the
+ * same measurement.
+ */
+void mergeResults(const std::vector<std::string>& inputs,
+                  const std::string& resultFile,
+                  const std::string& csvFile = std::string());
+
+#endif /* SHARDS_HXX */
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <vigra/hdf5impex.hxx>
+
+#include "storestatistics.hxx"
+#include "blockcache.hxx"
+#include "blocking.h"
+#include "blockstore.hxx"
+#include "buffers.hxx"
+#include "hdf5volume.hxx"
+#include "roiquery.hxx"
+#include "threadpool.hxx"
+
+namespace {
+
+/**
+ * compress 'data' in blocks of edge length l into the block store 'file'
+ */
+void writeStore(const vigra::MultiArrayView<3, uint32_t>& data, const std::string& name,
+                int l, const StoreOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl;
+
+    const BW::Roi<3> roi({0,0,0}, data.shape());
+    const BW::Blocking<3> blocking(roi, {l,l,l});
+    cout << "* writing " << blocking.numBlocks() << " blocks of " << name << " with L=" << l
+         << " and " << toString(options.codec) << " to " << options.file << endl;
+
+    BlockStoreWriter writer(options.file, blocking);
+    ThreadPool pool(options.nthreads);
+    std::vector<CodecBuffers> codecBuffers(pool.size());
+    BlockBufferPool blockBuffers;
+    for(size_t i=0; i<blocking.numBlocks(); ++i) {
+        pool.submit([&, i]() {
+            const BW::Roi<3> blockRoi = blocking[i].second;
+            BlockBufferPool::Handle buffer = blockBuffers.acquire(blockRoi.size());
+            const MultiArrayView<3, uint32_t> a = extractBlock<uint32_t>(data, blockRoi, buffer->data());
+            writer.add(i, a, options.codec, codecBuffers[ThreadPool::currentWorker()]);
+        });
+    }
+    pool.wait();
+    writer.close();
+
+    const double uncompressed = roi.size()*sizeof(uint32_t);
+    cout << "  " << writer.bytesWritten()/(1024.0*1024.0) << " MB, ratio "
+         << writer.bytesWritten()/uncompressed << ", " << writer.count(UNIFORM_BLOCK) << " uniform and "
+         << writer.count(DUPLICATE_BLOCK) << " duplicate blocks without payload" << endl;
+}
+
+/**
+ * the ROIs of a trace file, clipped to 'volume'
+ */
+std::vector<BW::Roi<3> > readTrace(const std::string& traceFile, const BW::Roi<3>& volume) {
+    std::ifstream in(traceFile.c_str());
+    if(!in) {
+        throw std::runtime_error("could not open trace " + traceFile);
+    }
+    std::vector<BW::Roi<3> > rois;
+    std::string line;
+    while(std::getline(in, line)) {
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream ss(line);
+        BW::Roi<3> roi;
+        if(!(ss >> roi.p[0] >> roi.p[1] >> roi.p[2] >> roi.q[0] >> roi.q[1] >> roi.q[2])) {
+            throw std::runtime_error("malformed line in trace " + traceFile + ": " + line);
+        }
+        BW::Roi<3> clipped;
+        if(roi.intersect(volume, clipped)) {
+            rois.push_back(clipped);
+        }
+    }
+    return rois;
+}
+
+} /* anonymous namespace */
+
+void readFirstDataset(const std::string& tgFile, vigra::MultiArray<3, uint32_t>& data, std::string& name) {
+    using namespace vigra;
+
+    std::vector<std::string> ls;
+    {
+        HDF5File f(tgFile, HDF5File::OpenReadOnly);
+        f.cd("blocks");
+        ls = f.ls();
+    }
+    if(ls.empty()) {
+        throw std::runtime_error("no topological grid blocks in " + tgFile);
+    }
+    std::sort(ls.begin(), ls.end());
+    name = ls[0];
+
+    HDF5Volume volume(tgFile, "blocks/" + name + "/topological-grid");
+    data.reshape(volume.shape());
+    volume.read(BW::Roi<3>({0,0,0}, volume.shape()), data);
+}
+
+void writeBlockStore(const std::string& tgFile, const StoreOptions& options) {
+    vigra::MultiArray<3, uint32_t> data;
+    std::string name;
+    readFirstDataset(tgFile, data, name);
+    writeStore(data, name, options.blockSize, options);
+}
+
+void storeStatistics(const StoreOptions& options) {
+    using std::cout; using std::endl;
+
+    BlockStore store(options.file);
+    cout << "* block store " << options.file << ": " << store.blocking().numBlocks() << " blocks, "
+         << store.sizeBytes()/(1024.0*1024.0) << " MB" << endl;
+
+    for(bool random : {false, true}) {
+        const AccessStatistics stat = benchmarkBlockStore(store, random, options.accesses);
+        const TimingSummary& t = stat.latency;
+        cout << "  " << (random ? "random    " : "sequential") << " "
+             << t.runs << " blocks, latency [ms] min / median / p90 / p99: "
+             << t.min << " / " << t.median << " / " << t.p90 << " / " << t.p99
+             << ", " << (stat.bytes/(1024*1024)) / stat.totalMs << " MB/ms" << endl;
+    }
+}
+
+void roiQueryStatistics(const std::string& tgFile, const StoreOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl;
+    typedef BW::Roi<3>::V V;
+
+    MultiArray<3, uint32_t> data;
+    std::string name;
+    readFirstDataset(tgFile, data, name);
+    const V shape = data.shape();
+
+    std::ofstream file("roiquery.txt", std::ios::trunc);
+    file /* 0 */ << "L "
+         /* 1 */ << "roiSize "
+         /* 2 */ << "queries "
+         /* 3 */ << "blocksPerQuery "
+         /* 4 */ << "latency_min "
+         /* 5 */ << "latency_median "
+         /* 6 */ << "latency_p90 "
+         /* 7 */ << "latency_p99 "
+         /* 8 */ << "MBPerMs"
+                 << endl;
+
+    for(int l : options.blockSizes) {
+        writeStore(data, name, l, options);
+        BlockStore store(options.file);
+        RoiQuery query(store, options.nthreads);
+
+        std::mt19937 rng(42);
+        for(int r : options.roiSizes) {
+            V roiShape;
+            for(int d=0; d<3; ++d) {
+                roiShape[d] = std::min<MultiArrayIndex>(r, shape[d]);
+            }
+            MultiArray<3, uint32_t> out(roiShape);
+
+            std::vector<double> times;
+            size_t blocks = 0;
+            double total = 0.0;
+            for(size_t k=0; k<options.accesses; ++k) {
+                V p;
+                for(int d=0; d<3; ++d) {
+                    p[d] = std::uniform_int_distribution<MultiArrayIndex>(0, shape[d]-roiShape[d])(rng);
+                }
+                Stopwatch t;
+                blocks += query.read(BW::Roi<3>(p, p+roiShape), out);
+                times.push_back(t.elapsedMs());
+                total += times.back();
+            }
+            const TimingSummary s = summarize(times);
+            const double mb = out.size()*sizeof(uint32_t)*options.accesses/(1024.0*1024.0);
+            cout << "  L=" << l << " roi=" << r << ": " << double(blocks)/options.accesses
+                 << " blocks/query, latency [ms] min / median / p90 / p99: "
+                 << s.min << " / " << s.median << " / " << s.p90 << " / " << s.p99 << endl;
+            file /* 0 */ << l << " "
+                 /* 1 */ << r << " "
+                 /* 2 */ << s.runs << " "
+                 /* 3 */ << double(blocks)/options.accesses << " "
+                 /* 4 */ << s.min << " "
+                 /* 5 */ << s.median << " "
+                 /* 6 */ << s.p90 << " "
+                 /* 7 */ << s.p99 << " "
+                 /* 8 */ << mb/total
+                         << endl;
+        }
+    }
+}
+
+void replayStatistics(const std::string& traceFile, const StoreOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl;
+
+    BlockStore store(options.file);
+    const std::vector<BW::Roi<3> > rois = readTrace(traceFile, store.blocking().roi());
+    cout << "* replaying " << rois.size() << " queries from " << traceFile
+         << " on " << options.file << endl;
+
+    size_t largest = 0;
+    for(const BW::Roi<3>& roi : rois) {
+        largest = std::max(largest, roi.size());
+    }
+    ArrayVector<uint32_t> buffer(largest);
+
+    std::ofstream file("replay.txt", std::ios::trunc);
+    file /* 0 */ << "cacheMB "
+         /* 1 */ << "queries "
+         /* 2 */ << "latency_min "
+         /* 3 */ << "latency_median "
+         /* 4 */ << "latency_p90 "
+         /* 5 */ << "latency_p99 "
+         /* 6 */ << "hits "
+         /* 7 */ << "misses "
+         /* 8 */ << "hitRate "
+         /* 9 */ << "evictions "
+         /*10 */ << "MBResident"
+                 << endl;
+
+    for(size_t budget : options.cacheBudgets) {
+        BlockCache cache(budget);
+        RoiQuery query(store, options.nthreads, budget > 0 ? &cache : 0);
+
+        std::vector<double> times;
+        times.reserve(rois.size());
+        for(const BW::Roi<3>& roi : rois) {
+            MultiArrayView<3, uint32_t> out(roi.shape(), buffer.data());
+            Stopwatch t;
+            query.read(roi, out);
+            times.push_back(t.elapsedMs());
+        }
+        const TimingSummary s = summarize(times);
+        const BlockCache::Counters c = cache.counters();
+        const double cacheMB = budget/(1024.0*1024.0);
+        const double residentMB = c.bytesResident/(1024.0*1024.0);
+
+        cout << "  cache " << cacheMB << " MB: latency [ms] min / median / p90 / p99: "
+             << s.min << " / " << s.median << " / " << s.p90 << " / " << s.p99
+             << ", hit rate " << c.hitRate() << " (" << c.evictions << " evictions, "
+             << residentMB << " MB resident)" << endl;
+        file /* 0 */ << cacheMB << " "
+             /* 1 */ << s.runs << " "
+             /* 2 */ << s.min << " "
+             /* 3 */ << s.median << " "
+             /* 4 */ << s.p90 << " "
+             /* 5 */ << s.p99 << " "
+             /* 6 */ << c.hits << " "
+             /* 7 */ << c.misses << " "
+             /* 8 */ << c.hitRate() << " "
+             /* 9 */ << c.evictions << " "
+             /*10 */ << residentMB
+                     << endl;
+    }
+}
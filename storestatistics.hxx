@@ -0,0 +1,77 @@
+#ifndef STORESTATISTICS_HXX
+#define STORESTATISTICS_HXX
+
+#include <string>
+#include <vector>
+
+#include "compressors.hxx"
+
+struct StoreOptions {
+    StoreOptions()
+      : blockSize(64)
+      , codec(vigra::LZ4)
+      , nthreads(1)
+      , accesses(1000)
+      , blockSizes({32, 64, 128, 256})
+      , roiSizes({16, 32, 64, 128, 256})
+      , cacheBudgets({0, size_t(64) << 20, size_t(256) << 20, size_t(1) << 30})
+      {}
+
+    /** block store file */
+    std::string file;
+    /** edge length of the stored blocks */
+    int blockSize;
+    /** codec every block is stored with */
+    Codec codec;
+    /** number of threads compressing blocks while writing */
+    int nthreads;
+    /** number of blocks decompressed per access pattern (or queries per ROI size) */
+    size_t accesses;
+    /** block edge lengths swept by roiQueryStatistics */
+    std::vector<int> blockSizes;
+    /** ROI edge lengths swept by roiQueryStatistics */
+    std::vector<int> roiSizes;
+    /** block cache sizes in bytes tried by replayStatistics, 0 means no cache */
+    std::vector<size_t> cacheBudgets;
+};
+
+/**
+ * load the first (in sorted order) topological grid dataset of 'tgFile'
+ * into 'data', setting 'name' to its name
+ */
+void readFirstDataset(const std::string& tgFile, vigra::MultiArray<3, uint32_t>& data,
+                      std::string& name);
+
+/**
+ * compress the first topological grid dataset of 'tgFile' in blocks of
+ * edge length options.blockSize and write them to the block store
+ * options.file
+ */
+void writeBlockStore(const std::string& tgFile, const StoreOptions& options);
+
+/**
+ * decompress blocks from the block store options.file in sequential and
+ * in random order and print the per-block latency percentiles
+ */
+void storeStatistics(const StoreOptions& options);
+
+/**
+ * for every block edge length in options.blockSizes, write the first
+ * topological grid dataset of 'tgFile' to the block store options.file and
+ * answer options.accesses randomly placed cubic ROI queries of every size
+ * in options.roiSizes; prints the query latency percentiles and writes
+ * them to roiquery.txt
+ */
+void roiQueryStatistics(const std::string& tgFile, const StoreOptions& options);
+
+/**
+ * replay the ROI queries recorded in 'traceFile' against the block store
+ * options.file once for every cache size in options.cacheBudgets; prints
+ * latency percentiles and the cache counters and writes them to replay.txt
+ *
+ * The trace has one query per line, "x0 y0 z0 x1 y1 z1" for the ROI
+ * [x0,x1) x [y0,y1) x [z0,z1); lines starting with '#' are skipped.
+ */
+void replayStatistics(const std::string& traceFile, const StoreOptions& options);
+
+#endif /* STORESTATISTICS_HXX */
@@ -1,13 +1,173 @@
 #include "supervoxels.hxx"
 
-#include <vigra/accumulator.hxx>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
 
 #include <cgp/GeometryReader.hxx>
 
+#include "benchmark.hxx"
+#include "blocking.h"
+#include "hdf5volume.hxx"
+#include "pipeline.hxx"
+#include "threadpool.hxx"
+
 typedef unsigned int label_type;
 typedef short coordinate_type;
 typedef cgp::hdf5::GeometryReader<label_type, coordinate_type> GeometryReader;
 
+namespace {
+    double percentileSorted(const std::vector<size_t>& sizes, double q) {
+        const double pos = q*(sizes.size()-1);
+        const size_t lo = static_cast<size_t>(std::floor(pos));
+        const size_t hi = std::min(lo+1, sizes.size()-1);
+        const double w = pos - lo;
+        return (1.0-w)*sizes[lo] + w*sizes[hi];
+    }
+
+    /**
+     * count the labels of the 'n' contiguous voxels at 'data' on 'pool',
+     * each worker adding to its own entry of 'counts'
+     */
+    void countParallel(const uint32_t* data, size_t n, CountKernel kernel, ThreadPool& pool,
+                       std::vector<LabelCounts>& counts) {
+        const size_t parts = 4*pool.size();
+        for(size_t k=0; k<parts; ++k) {
+            const size_t b = n*k/parts;
+            const size_t e = n*(k+1)/parts;
+            pool.submit([data, b, e, kernel, &counts]() {
+                counts[ThreadPool::currentWorker()].add(data+b, e-b, kernel);
+            });
+        }
+        pool.wait();
+    }
+
+    void printCounts(const LabelCounts& total) {
+        // label 0 is the background and not part of sizes()
+        std::vector<size_t> sizes = total.sizes();
+        printSizeDistribution("supervoxel size", sizeDistribution(sizes));
+    }
+
+    /**
+     * time every kernel single-threaded on the 'n' voxels at 'data', with a
+     * dense and (except for the accumulator) a hashed count table
+     */
+    void benchmarkKernels(const uint32_t* data, size_t n) {
+        using std::cout; using std::endl; using std::setw;
+        const int repetitions = 5;
+
+        cout << "  count kernels on " << n << " voxels (median of " << repetitions << " runs):" << endl;
+        for(const auto& kv : countKernelList()) {
+            for(int hashed=0; hashed<2; ++hashed) {
+                if(hashed && kv.second == ACCUMULATOR_KERNEL) {
+                    continue;
+                }
+                std::vector<double> ms;
+                for(int r=0; r<repetitions; ++r) {
+                    LabelCounts c(hashed ? 0 : LabelCounts::DEFAULT_DENSE_LIMIT);
+                    Stopwatch t;
+                    c.add(data, n, kv.second);
+                    ms.push_back(t.elapsedMs());
+                }
+                const double m = percentile(ms, 0.5);
+                cout << "    " << setw(12) << toString(kv.second) << setw(8)
+                     << (hashed ? "hashed" : "dense") << ": " << setw(10) << m << " ms, "
+                     << n/(1000.0*m) << " MVoxel/s" << endl;
+            }
+        }
+    }
+
+    /**
+     * throw unless 'counts' equals the reference counts of the accumulator
+     */
+    void validateCounts(const LabelCounts& counts, const LabelCounts& reference) {
+        if(!(counts == reference)) {
+            throw std::runtime_error("supervoxelStatistics: label counts differ from the accumulator's");
+        }
+        std::cout << "  label counts match the accumulator's (" << reference.sizes().size()
+                  << " labels)" << std::endl;
+    }
+
+    /**
+     * print how long 'phase' took and how much memory is resident after it
+     */
+    void printPhase(const std::string& phase, double ms) {
+        std::cout << "  " << phase << ": " << ms/1000.0 << " s, "
+                  << residentBytes()/(1024.0*1024.0) << " MB resident (peak "
+                  << peakResidentBytes()/(1024.0*1024.0) << " MB)" << std::endl;
+    }
+
+    /**
+     * sizes of the cells 1 ... maxLabel of 'dimension', queried on 'pool';
+     * each worker fills its own range of labels
+     */
+    template<class G>
+    std::vector<size_t> cellSizes(const G& g, int dimension, ThreadPool& pool) {
+        const size_t n = g.maxLabel(dimension);
+        std::vector<size_t> sizes(n, 0);
+        const size_t parts = 4*pool.size();
+        for(size_t k=0; k<parts; ++k) {
+            const size_t b = n*k/parts;
+            const size_t e = n*(k+1)/parts;
+            pool.submit([&g, &sizes, dimension, b, e]() {
+                for(size_t i=b; i<e; ++i) {
+                    sizes[i] = g.size(dimension, static_cast<label_type>(i+1));
+                }
+            });
+        }
+        pool.wait();
+        return sizes;
+    }
+} /* anonymous namespace */
+
+SizeDistribution sizeDistribution(std::vector<size_t>& sizes) {
+    sizes.erase(std::remove(sizes.begin(), sizes.end(), 0), sizes.end());
+    std::sort(sizes.begin(), sizes.end());
+
+    SizeDistribution d;
+    d.regions = sizes.size();
+    if(sizes.empty()) {
+        return d;
+    }
+    d.min    = sizes.front();
+    d.max    = sizes.back();
+    d.mean   = std::accumulate(sizes.begin(), sizes.end(), 0.0) / sizes.size();
+    d.median = percentileSorted(sizes, 0.5);
+    d.p10    = percentileSorted(sizes, 0.1);
+    d.p90    = percentileSorted(sizes, 0.9);
+    d.p99    = percentileSorted(sizes, 0.99);
+    for(size_t s : sizes) {
+        size_t k = 0;
+        while((size_t(2) << k) <= s) {
+            ++k;
+        }
+        if(k >= d.histogram.size()) {
+            d.histogram.resize(k+1, 0);
+        }
+        ++d.histogram[k];
+    }
+    return d;
+}
+
+void printSizeDistribution(const std::string& name, const SizeDistribution& d) {
+    using std::cout; using std::endl;
+
+    cout << name << ": " << d.regions << " regions, mean " << d.mean
+         << ", min / p10 / median / p90 / p99 / max: "
+         << d.min << " / " << d.p10 << " / " << d.median << " / "
+         << d.p90 << " / " << d.p99 << " / " << d.max << endl;
+    for(size_t k=0; k<d.histogram.size(); ++k) {
+        if(d.histogram[k] == 0) {
+            continue;
+        }
+        cout << name << ": [" << (size_t(1) << k) << ", " << (size_t(2) << k) << ") "
+             << d.histogram[k] << endl;
+    }
+}
+
 void statistic(const GeometryReader& g, int dimension) {
     std::vector<size_t> sizes(g.maxLabel(dimension));
     for(size_t i=1; i<g.maxLabel(dimension); ++i) {
@@ -18,31 +178,108 @@ void statistic(const GeometryReader& g, int dimension) {
               << std::endl;
 }
 
-void supervoxelStatistics(const vigra::MultiArrayView<3, uint32_t>& seg) {
+void supervoxelStatistics(const vigra::MultiArrayView<3, uint32_t>& seg, int nthreads) {
+    if(!seg.isUnstrided()) {
+        throw std::runtime_error("supervoxelStatistics: segmentation must be unstrided");
+    }
+    ThreadPool pool(nthreads);
+    std::vector<LabelCounts> counts(pool.size());
+    countParallel(seg.data(), seg.size(), RUNS_KERNEL, pool, counts);
+    printCounts(LabelCounts::merge(counts, pool));
+}
+
+void supervoxelStatistics(const std::string& file, const std::string& dataset,
+                          const SupervoxelOptions& options) {
     using namespace vigra;
-    using namespace vigra::acc;
-    AccumulatorChainArray<CoupledArrays<3, uint32_t, uint32_t>, 
-                                        Select<DataArg<1>, LabelArg<2>,
-                                        RegionCenter> > a;
-    auto start = createCoupledIterator(seg, seg);
-    auto end = start.getEndIterator();
-    extractFeatures(start, end, a);
-    double avg = 0.0;
-    for(size_t i=1; i<=a.maxRegionLabel(); ++i) {
-        avg += get<Count>(a,i);
-    }
-    avg /= ((double)a.maxRegionLabel());
-    std::cout << "avg supervoxel size: " << avg << std::endl;
+    using std::cout; using std::endl;
+
+    HDF5Volume volume(file, dataset);
+    const HDF5Volume::Shape shape = volume.shape();
+    // the brick being counted and the one being read share the budget
+    const HDF5Volume::Shape brick = brickShape(shape, HDF5Volume::Shape(1,1,1),
+                                               volume.chunkShape(), options.memoryBudget/2);
+    const BW::Blocking<3> bricks(BW::Roi<3>({0,0,0}, shape), brick);
+    cout << "* counting supervoxels of " << file << "/" << dataset << " " << shape
+         << " in " << bricks.numBlocks() << " bricks of " << brick << endl;
+
+    struct Brick {
+        BW::Roi<3> roi;
+        MultiArray<3, uint32_t> buffer;
+    };
+    size_t next = 0;
+    Prefetcher<Brick> reader([&](Brick& b) {
+        if(next >= bricks.numBlocks()) {
+            return false;
+        }
+        b.roi = bricks[next++].second;
+        if(b.buffer.size() < prod(brick)) {
+            b.buffer.reshape(brick);
+        }
+        volume.read(b.roi, MultiArrayView<3, uint32_t>(b.roi.shape(), b.buffer.data()));
+        return true;
+    }, 1);
+
+    ThreadPool pool(options.nthreads);
+    std::vector<LabelCounts> counts(pool.size());
+    LabelCounts reference;
+    bool first = true;
+    double countMs = 0.0;
+    Stopwatch t;
+    while(Brick* b = reader.next()) {
+        if(options.benchmark && first) {
+            benchmarkKernels(b->buffer.data(), b->roi.size());
+        }
+        first = false;
+        Stopwatch c;
+        countParallel(b->buffer.data(), b->roi.size(), options.kernel, pool, counts);
+        countMs += c.elapsedMs();
+        if(options.validate) {
+            reference.add(b->buffer.data(), b->roi.size(), ACCUMULATOR_KERNEL);
+        }
+    }
+    const double ms = t.elapsedMs();
+    Stopwatch m;
+    const LabelCounts total = LabelCounts::merge(counts, pool);
+    const double mergeMs = m.elapsedMs();
+    cout << "  " << ms/1000.0 << " s (" << reader.waitMs()/1000.0 << " s waiting for reads), "
+         << volume.bytesRead()/(1024.0*1024.0)/(ms/1000.0) << " MB/s" << endl;
+    cout << "  " << toString(options.kernel) << " kernel: " << countMs/1000.0 << " s counting, "
+         << mergeMs/1000.0 << " s merging " << pool.size() << " "
+         << (total.isDense() ? "dense" : "hashed") << " tables" << endl;
+    if(options.validate) {
+        validateCounts(total, reference);
+    }
+    printCounts(total);
 }
 
-void gStatistics(const std::string& geomFile) {
-    GeometryReader g(geomFile, GeometryReader::EnableZeroSetBoundsQuery |
-        GeometryReader::EnableOneSetBoundsQuery |
-        GeometryReader::EnableTwoSetBoundsQuery |
-        GeometryReader::EnableOneSetBoundedByQuery |
-        GeometryReader::EnableTwoSetBoundedByQuery |
-        GeometryReader::EnableThreeSetBoundedByQuery);
-    for(int d=1; d<3; ++d) {
-        statistic(g, d);
-    }
-}
\ No newline at end of file
+void gStatistics(const std::string& geomFile, const GeometryOptions& options) {
+    using std::cout; using std::endl;
+
+    if(!options.fast) {
+        GeometryReader g(geomFile, GeometryReader::EnableZeroSetBoundsQuery |
+            GeometryReader::EnableOneSetBoundsQuery |
+            GeometryReader::EnableTwoSetBoundsQuery |
+            GeometryReader::EnableOneSetBoundedByQuery |
+            GeometryReader::EnableTwoSetBoundedByQuery |
+            GeometryReader::EnableThreeSetBoundedByQuery);
+        for(int d=1; d<3; ++d) {
+            statistic(g, d);
+        }
+        return;
+    }
+
+    cout << "* cell sizes of " << geomFile << endl;
+    Stopwatch t;
+    // sizes need none of the bounds / bounded-by indices
+    GeometryReader g(geomFile, 0);
+    printPhase("open", t.elapsedMs());
+
+    ThreadPool pool(options.nthreads);
+    for(int d=1; d<=3; ++d) {
+        t.restart();
+        std::vector<size_t> sizes = cellSizes(g, d, pool);
+        const SizeDistribution dist = sizeDistribution(sizes);
+        printPhase(std::to_string(d) + "-sets", t.elapsedMs());
+        printSizeDistribution(std::to_string(d) + "-set size", dist);
+    }
+}
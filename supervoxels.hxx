@@ -2,9 +2,93 @@
 #define SUPERVOXELS_HXX
 
 #include <string>
+#include <vector>
+
 #include <vigra/multi_array.hxx>
 
-void gStatistics(const std::string& geomFile);
-void supervoxelStatistics(const vigra::MultiArrayView<3, uint32_t>& seg);
+#include "labelcounts.hxx"
+
+/**
+ * summary of a set of region sizes
+ */
+struct SizeDistribution {
+    SizeDistribution()
+      : regions(0), min(0), max(0), mean(0), median(0), p10(0), p90(0), p99(0)
+      {}
+
+    size_t regions;
+    size_t min;
+    size_t max;
+    double mean;
+    double median;
+    double p10;
+    double p90;
+    double p99;
+    /** histogram[k] is the number of regions with a size in [2^k, 2^(k+1)) */
+    std::vector<size_t> histogram;
+};
+
+/**
+ * distribution of the non-zero entries of 'sizes' (sorted in place)
+ */
+SizeDistribution sizeDistribution(std::vector<size_t>& sizes);
+
+/**
+ * print 'd' with every line prefixed by 'name'
+ */
+void printSizeDistribution(const std::string& name, const SizeDistribution& d);
+
+struct SupervoxelOptions {
+    SupervoxelOptions()
+      : nthreads(1)
+      , memoryBudget(size_t(1) << 30)
+      , kernel(RUNS_KERNEL)
+      , validate(false)
+      , benchmark(false)
+      {}
+
+    /** number of threads counting labels */
+    int nthreads;
+    /** maximum size in bytes of one brick read from the file */
+    size_t memoryBudget;
+    /** how the voxels of each label are counted */
+    CountKernel kernel;
+    /** also count with ACCUMULATOR_KERNEL and fail if the counts differ */
+    bool validate;
+    /** time every kernel on the first brick before counting */
+    bool benchmark;
+};
+
+struct GeometryOptions {
+    GeometryOptions()
+      : nthreads(1)
+      , fast(false)
+      {}
+
+    /** number of threads querying cell sizes in fast mode */
+    int nthreads;
+    /**
+     * open the geometry file without any query index and print the size
+     * distributions of the 1-, 2- and 3-sets, with time and memory per phase;
+     * otherwise print the average 1- and 2-set size
+     */
+    bool fast;
+};
+
+void gStatistics(const std::string& geomFile,
+                 const GeometryOptions& options = GeometryOptions());
+
+/**
+ * size distribution of the supervoxels (labels > 0) of 'seg'
+ */
+void supervoxelStatistics(const vigra::MultiArrayView<3, uint32_t>& seg, int nthreads = 1);
+
+/**
+ * as above, but streams the segmentation 'dataset' in 'file' brick by
+ * brick (at most options.memoryBudget bytes each, the next brick is read
+ * while the current one is counted) instead of loading it whole
+ */
+void supervoxelStatistics(const std::string& file, const std::string& dataset,
+                          const SupervoxelOptions& options);
 
-#endif /* SUPERVOXELS_HXX */
\ No newline at end of file
+#endif /* SUPERVOXELS_HXX */
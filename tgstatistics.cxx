@@ -0,0 +1,643 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <vigra/hdf5impex.hxx>
+#include <vigra/compression.hxx>
+
+#include "tgstatistics.hxx"
+#include "compressors.hxx"
+#include "blockdedup.hxx"
+#include "blocking.h"
+#include "threadpool.hxx"
+#include "buffers.hxx"
+#include "hdf5volume.hxx"
+#include "pipeline.hxx"
+#include "rawvolume.hxx"
+#include "resultcache.hxx"
+#include "resultsink.hxx"
+#include "trace.hxx"
+
+namespace {
+
+/**
+ * compresses sub-blocks with all codecs on a thread pool and hands
+ * the results to a ResultSink, where codecs are named e.g. LZ4 or
+ * DELTA+LZ4 for filtered blocks
+ */
+class TgBenchmark {
+    public:
+    TgBenchmark(const TgOptions& options);
+
+    /**
+     * compress all blocks of 'blocking', which must lie inside 'dataRoi';
+     * 'data' holds the voxels of 'dataRoi'
+     */
+    void run(const vigra::MultiArrayView<3, uint32_t>& data,
+             const BW::Roi<3>& dataRoi,
+             const BW::Blocking<3>& blocking);
+
+    /**
+     * the following run()s tile dataset number 'dataset', which covers
+     * 'volume', with blocks of edge length 'l'; starts a new progress line
+     */
+    void startDataset(size_t dataset, int l, const BW::Roi<3>& volume);
+
+    /**
+     * from now on, compress only the sub-blocks owned by 'shard'; the
+     * default shard owns all of them
+     */
+    void setBlockShard(const Shard& shard) { blockShard_ = shard; }
+    void endProgress();
+
+    /**
+     * write all pending results (and cache entries), rethrowing write errors
+     */
+    void close();
+
+    /**
+     * with options.cacheFile, print how many measurements came from the cache
+     */
+    void printCache() const;
+
+    /**
+     * with options.select, print the per-block codec selection of every L
+     */
+    void printSelection() const;
+
+    int numThreads() const { return pool_.size(); }
+
+    private:
+    void write(const std::vector<std::vector<CompressionStatistics> >& results,
+               const std::vector<uint64_t>& ids,
+               const std::vector<BlockKind>& kinds);
+
+    /** count one finished (sub-block, codec) pair */
+    void progress();
+
+    /**
+     * sub-block 'id' of the current dataset and L belongs to
+     * blockShard_; L is part of the unit so that the few blocks of
+     * large L do not all go to the first shards. With dedup_, the
+     * sub-block's 'digest' is given and a non-uniform one is assigned by
+     * it instead, so that all copies of a sub-block (and thus the
+     * uniform / duplicate / unique split) end up in the same shard.
+     */
+    bool owned(uint64_t id, const DedupIndex::Digest* digest = 0) const {
+        if(digest && !digest->uniform) {
+            return blockShard_.owns(digest->a);
+        }
+        return blockShard_.owns(id + dataset_ + progressL_);
+    }
+
+    /**
+     * whether owned() depends on the digests, so the number of owned
+     * sub-blocks is only known as run() sees them
+     */
+    bool shardsByDigest() const { return dedup_ && blockShard_.count > 1; }
+
+    const TgOptions& options_;
+    std::vector<Codec> codecs_;
+    ResultSink sink_;
+    std::unique_ptr<CodecSelector> selector_;
+    std::map<int, SelectionReport> selection_;
+    Shard blockShard_;
+    std::unique_ptr<ResultCache> cache_;
+    /** uniform and duplicate sub-blocks of the current dataset and L */
+    std::unique_ptr<DedupIndex> dedup_;
+    /** ResultCache::paramsHash() of every codec */
+    std::vector<uint64_t> params_;
+
+    ThreadPool pool_;
+
+    // scratch memory is reused across all blocks; after the first few blocks
+    // of the largest L the loop no longer allocates buffers
+    BlockBufferPool blockBuffers_;
+    std::vector<CodecBuffers> codecBuffers_;
+
+    // dataset and blocking the block ids in the results refer to
+    size_t dataset_;
+    BW::Blocking<3> volumeBlocking_;
+
+    std::mutex progressMutex_;
+    int progressL_;
+    size_t progressTotal_;
+    size_t progressDone_;
+};
+
+/**
+ * what storing a uniform (its label) or duplicate (the id of the original)
+ * sub-block of 'voxels' voxels costs, for every codec
+ */
+CompressionStatistics constantEncoding(const Codec& codec, size_t voxels, BlockKind kind) {
+    CompressionStatistics stat(codec);
+    stat.sizeBytesUncompressed = voxels*sizeof(uint32_t);
+    stat.sizeBytesCompressed = kind == UNIFORM_BLOCK ? sizeof(uint32_t) : sizeof(uint64_t);
+    return stat;
+}
+
+std::vector<std::string> codecNames(const std::vector<Codec>& codecs) {
+    std::vector<std::string> names;
+    for(const Codec& codec : codecs) {
+        names.push_back(toString(codec));
+    }
+    return names;
+}
+
+TgBenchmark::TgBenchmark(const TgOptions& options)
+    : options_(options)
+    , codecs_(codecList(options.filters))
+    , sink_(options.resultFile, codecNames(codecs_), options.csvFile)
+    , selector_(options.select ? new CodecSelector(codecs_, options.objective,
+                                                   options.selectSample, options.codecThreads)
+                               : 0)
+    , cache_(options.cacheFile.empty() ? 0 : new ResultCache(options.cacheFile,
+                                                             options.checkpointSeconds))
+    , dedup_(options.dedup ? new DedupIndex : 0)
+    , pool_(options.nthreads)
+    , codecBuffers_(pool_.size())
+    , dataset_(0)
+    , progressL_(0)
+    , progressTotal_(0)
+    , progressDone_(0)
+{
+    for(const Codec& codec : codecs_) {
+        params_.push_back(ResultCache::paramsHash(codec, options.codecThreads, options.timing));
+    }
+}
+
+void TgBenchmark::close() {
+    sink_.close();
+    if(cache_) {
+        cache_->checkpoint();
+    }
+}
+
+void TgBenchmark::printCache() const {
+    if(cache_) {
+        std::cout << "result cache " << options_.cacheFile << ": " << cache_->hits() << " measurements reused, "
+                  << cache_->misses() << " computed, " << cache_->size() << " cached" << std::endl;
+    }
+}
+
+void TgBenchmark::progress() {
+    std::lock_guard<std::mutex> lock(progressMutex_);
+    if(++progressDone_ % codecs_.size() == 0) {
+        std::cout << "\rcompressing " << progressTotal_ << " blocks with L=" << progressL_ << " "
+                  << "[" << progressDone_/codecs_.size() << "/" << progressTotal_ << "]" << std::flush;
+    }
+}
+
+void TgBenchmark::startDataset(size_t dataset, int l, const BW::Roi<3>& volume) {
+    dataset_ = dataset;
+    volumeBlocking_ = BW::Blocking<3>(volume, {l,l,l});
+    progressL_ = l;
+    progressTotal_ = 0;
+    for(size_t id=0; !shardsByDigest() && id<volumeBlocking_.numBlocks(); ++id) {
+        progressTotal_ += owned(id) ? 1 : 0;
+    }
+    progressDone_ = 0;
+    if(dedup_) {
+        dedup_->clear();
+    }
+}
+
+void TgBenchmark::endProgress() {
+    std::cout << std::endl;
+    if(dedup_) {
+        std::cout << "  " << dedup_->count(UNIFORM_BLOCK) << " uniform and " << dedup_->count(DUPLICATE_BLOCK)
+                  << " duplicate of " << progressTotal_ << " sub-blocks not compressed" << std::endl;
+    }
+}
+
+void TgBenchmark::run(
+    const vigra::MultiArrayView<3, uint32_t>& data,
+    const BW::Roi<3>& dataRoi,
+    const BW::Blocking<3>& blocking
+) {
+    using namespace vigra;
+
+    // relative to 'data'
+    const auto relative = [&](const BW::Roi<3>& roi) -> BW::Roi<3> {
+        return BW::Roi<3>(roi.p - dataRoi.p, roi.q - dataRoi.p);
+    };
+
+    // With dedup_, the digests of all sub-blocks are computed in
+    // parallel, straight from 'data'; they also decide the shard.
+    std::vector<DedupIndex::Digest> digests;
+    if(dedup_) {
+        digests.resize(blocking.numBlocks());
+        for(size_t i=0; i<blocking.numBlocks(); ++i) {
+            pool_.submit([&, i]() {
+                const BW::Roi<3> roi = relative(blocking[i].second);
+                digests[i] = DedupIndex::digest(data.subarray(roi.p, roi.q));
+            });
+        }
+        pool_.wait();
+    }
+
+    // 'blocking' may only cover a brick of the dataset; ids[k] is the id of
+    // sub-block blocks[k] in the dataset's blocking
+    std::vector<size_t> blocks;
+    std::vector<uint64_t> ids;
+    for(size_t i=0; i<blocking.numBlocks(); ++i) {
+        const uint64_t id = volumeBlocking_.indexOfBlockContaining(blocking[i].second.p);
+        if(owned(id, dedup_ ? &digests[i] : 0)) {
+            blocks.push_back(i);
+            ids.push_back(id);
+        }
+    }
+    const size_t numBlocks = blocks.size();
+    if(shardsByDigest()) {
+        progressTotal_ += numBlocks;
+    }
+
+    // one slot per (sub-block, codec) pair, so that tasks never share results
+    std::vector<std::vector<CompressionStatistics> > results(
+        numBlocks, std::vector<CompressionStatistics>(codecs_.size()));
+    std::vector<size_t> selected(numBlocks, 0);
+    std::vector<double> selectMs(numBlocks, 0.0);
+    std::vector<BlockKind> kinds(numBlocks, UNIQUE_BLOCK);
+
+    const auto blockRoi = [&](size_t i) { return relative(blocking[blocks[i]].second); };
+
+    if(dedup_) {
+        // classify in block order, so that the first of several equal
+        // sub-blocks is always the original
+        for(size_t i=0; i<numBlocks; ++i) {
+            uint64_t original = 0;
+            kinds[i] = dedup_->classify(blockRoi(i).shape(), digests[blocks[i]], ids[i], original);
+        }
+    }
+
+    // Each block task extracts its sub-block once and spawns one task
+    // per codec; idle workers steal these codec tasks.
+    for(size_t i=0; i<numBlocks; ++i) {
+        pool_.submit([&, i]() {
+            const BW::Roi<3> roi = blockRoi(i);
+            if(kinds[i] != UNIQUE_BLOCK) {
+                for(size_t c=0; c<codecs_.size(); ++c) {
+                    results[i][c] = constantEncoding(codecs_[c], roi.size(), kinds[i]);
+                    progress();
+                }
+                return;
+            }
+            BlockBufferPool::Handle buffer = blockBuffers_.acquire(roi.size());
+            const MultiArrayView<3, uint32_t> a = extractBlock<uint32_t>(data, roi, buffer->data());
+            const uint64_t content = cache_ ? ResultCache::contentHash(a) : 0;
+            for(size_t c=0; c<codecs_.size(); ++c) {
+                if(cache_) {
+                    const ResultCache::Key key = {content, params_[c]};
+                    results[i][c] = CompressionStatistics(codecs_[c]);
+                    if(cache_->find(key, results[i][c])) {
+                        progress();
+                        continue;
+                    }
+                }
+                pool_.submit([&, i, c, a, buffer, content]() {
+                    CodecBuffers& buffers = codecBuffers_[ThreadPool::currentWorker()];
+                    results[i][c] = statCompressor(a, codecs_[c], options_.codecThreads,
+                                                   options_.timing, buffers);
+                    if(cache_) {
+                        const ResultCache::Key key = {content, params_[c]};
+                        cache_->insert(key, results[i][c]);
+                    }
+                    progress();
+                });
+            }
+            if(selector_) {
+                // the codec tasks are already queued for idle workers
+                Stopwatch t;
+                selected[i] = selector_->select(a, codecBuffers_[ThreadPool::currentWorker()]);
+                selectMs[i] = t.elapsedMs();
+            }
+        });
+    }
+    pool_.wait();
+
+    if(selector_) {
+        SelectionReport& report = selection_.insert(
+            std::make_pair(progressL_, SelectionReport(codecs_.size()))).first->second;
+        for(size_t i=0; i<numBlocks; ++i) {
+            // the selector only sees sub-blocks that need a codec
+            if(kinds[i] == UNIQUE_BLOCK) {
+                report.add(results[i], selected[i], selectMs[i]);
+            }
+        }
+    }
+    write(results, ids, kinds);
+}
+
+void TgBenchmark::printSelection() const {
+    for(const auto& kv : selection_) {
+        kv.second.print("codec selection L=" + std::to_string(kv.first), *selector_);
+    }
+}
+
+void TgBenchmark::write(
+    const std::vector<std::vector<CompressionStatistics> >& results,
+    const std::vector<uint64_t>& ids,
+    const std::vector<BlockKind>& kinds
+) {
+    for(size_t i=0; i<results.size(); ++i) {
+        const uint64_t block = ids[i];
+        for(size_t c=0; c<results[i].size(); ++c) {
+            const CompressionStatistics& stat = results[i][c];
+            const TimingSummary& tc = stat.compressTiming;
+            const TimingSummary& tu = stat.uncompressTiming;
+            ResultRecord r;
+            r.block = block;
+            r.dataset = dataset_;
+            r.L = progressL_;
+            r.codec = c;
+            r.runs = tc.runs;
+            r.sizeBytesUncompressed = stat.sizeBytesUncompressed;
+            r.sizeBytesCompressed = stat.sizeBytesCompressed;
+            r.timeCompress = stat.timeCompress;
+            r.timeUncompress = stat.timeUncompress;
+            r.timeFilter = stat.timeFilter;
+            r.timeUnfilter = stat.timeUnfilter;
+            r.compressMin = tc.min;
+            r.compressP90 = tc.p90;
+            r.compressP99 = tc.p99;
+            r.uncompressMin = tu.min;
+            r.uncompressP90 = tu.p90;
+            r.uncompressP99 = tu.p99;
+            r.kind = kinds[i];
+            sink_.add(r);
+        }
+    }
+}
+
+const std::vector<int> L = {32, 64, 92, 128, 160, 192, 256};
+
+/**
+ * a region of a topological grid dataset together with
+ * the block edge lengths it is to be tiled with
+ */
+struct TgChunk {
+    std::string dataset;
+    /** position of 'dataset' in the sorted list of datasets */
+    size_t datasetIndex;
+    /** extent of the whole dataset */
+    BW::Roi<3> volume;
+    /** region held in 'data' */
+    BW::Roi<3> roi;
+    std::vector<int> ls;
+    /** backing memory of data(), reused between chunks */
+    vigra::MultiArray<3, uint32_t> buffer;
+    /**
+     * if set, data() points into the memory mapping of this volume
+     * instead of into 'buffer', and keeps the mapping alive
+     */
+    std::shared_ptr<Volume> mapped;
+
+    /** the voxels of 'roi' */
+    vigra::MultiArrayView<3, uint32_t> data() const {
+        if(mapped) {
+            return mapped->mapped().subarray(roi.p, roi.q);
+        }
+        return vigra::MultiArrayView<3, uint32_t>(roi.shape(), buffer.data());
+    }
+};
+
+/**
+ * Produces the chunks of all datasets in a tg file (or a directory of
+ * volume directories written by convertTg): one chunk per dataset holding
+ * all of it, or, when streaming, one chunk per brick and L. Memory mapped
+ * volumes are not copied, their chunks refer to the mapping.
+ */
+class TgReader {
+    public:
+    TgReader(const std::string& tgFile, const TgOptions& options);
+
+    /** number of datasets this reader produces chunks of */
+    size_t numDatasets() const { return datasets_.size(); }
+
+    /**
+     * whether options.shard has too few datasets to split them, so that
+     * every shard reads all of them and the sub-blocks must be split
+     */
+    bool shardsBlocks() const { return shardBlocks_; }
+
+    /**
+     * fill 'chunk' with the next chunk, return false at the end
+     */
+    bool next(TgChunk& chunk);
+
+    private:
+    bool nextBrick(TgChunk& chunk);
+    void startBricks();
+    /** open the next dataset, return false at the end */
+    bool nextDataset();
+    /** the volume of dataset 'name' */
+    std::shared_ptr<Volume> openVolume(const std::string& name) const;
+
+    const TgOptions& options_;
+    std::string tgFile_;
+    /** 0 if tgFile_ is a directory */
+    std::unique_ptr<vigra::HDF5File> file_;
+    std::vector<std::string> ls_;
+    /** positions in ls_ of the datasets to read, in order */
+    std::vector<size_t> datasets_;
+    bool shardBlocks_;
+    /** position in datasets_ of the next dataset */
+    size_t next_;
+    /** position in ls_ of the current dataset */
+    size_t dataset_;
+
+    // streaming state
+    std::string volumeName_;
+    std::shared_ptr<Volume> volume_;
+    size_t l_;
+    BW::Blocking<3> bricks_;
+    size_t brick_;
+};
+
+TgReader::TgReader(const std::string& tgFile, const TgOptions& options)
+    : options_(options)
+    , tgFile_(tgFile)
+    , shardBlocks_(false)
+    , next_(0)
+    , dataset_(0)
+    , l_(0)
+    , brick_(0)
+{
+    if(isDirectory(tgFile)) {
+        ls_ = listVolumes(tgFile);
+    }
+    else {
+        file_.reset(new vigra::HDF5File(tgFile, vigra::HDF5File::OpenReadOnly));
+        file_->cd("blocks");
+        ls_ = file_->ls();
+        std::sort(ls_.begin(), ls_.end());
+    }
+
+    const size_t considered = std::min(ls_.size(), size_t(std::max(0, options.maxBlocks)));
+    const Shard& shard = options.shard;
+    shardBlocks_ = considered < size_t(shard.count);
+    for(size_t d=0; d<considered; ++d) {
+        if(shardBlocks_ || shard.owns(d)) {
+            datasets_.push_back(d);
+        }
+    }
+}
+
+bool TgReader::nextDataset() {
+    if(next_ >= datasets_.size()) {
+        return false;
+    }
+    dataset_ = datasets_[next_++];
+    return true;
+}
+
+std::shared_ptr<Volume> TgReader::openVolume(const std::string& name) const {
+    if(file_) {
+        return std::make_shared<HDF5Volume>(tgFile_, "blocks/" + name + "/topological-grid");
+    }
+    return std::make_shared<RawVolume>(tgFile_ + "/" + name, options_.readThreads);
+}
+
+bool TgReader::next(TgChunk& chunk) {
+    if(options_.streaming) {
+        return nextBrick(chunk);
+    }
+    if(!nextDataset()) {
+        return false;
+    }
+    const std::string& x = ls_[dataset_];
+    chunk.mapped.reset();
+    if(file_) {
+        // readAndResize only reallocates if the shape changes
+        TRACE_SPAN("hdf5 read");
+        file_->cd(x);
+        file_->readAndResize("topological-grid", chunk.buffer);
+        file_->cd_up();
+        trace::add(trace::BYTES_READ, chunk.buffer.size()*sizeof(uint32_t));
+        chunk.volume = BW::Roi<3>({0,0,0}, chunk.buffer.shape());
+    }
+    else {
+        std::shared_ptr<Volume> volume = openVolume(x);
+        chunk.volume = BW::Roi<3>({0,0,0}, volume->shape());
+        if(volume->mapped().hasData()) {
+            chunk.mapped = volume;
+        }
+        else {
+            if(chunk.buffer.shape() != volume->shape()) {
+                chunk.buffer.reshape(volume->shape());
+            }
+            volume->read(chunk.volume, chunk.buffer);
+        }
+    }
+
+    chunk.dataset = x;
+    chunk.datasetIndex = dataset_;
+    chunk.roi = chunk.volume;
+    chunk.ls = L;
+    return true;
+}
+
+void TgReader::startBricks() {
+    const int l = L[l_];
+    // a mapped volume costs no memory, so it is a single brick
+    const Volume::Shape brick = volume_->mapped().hasData()
+        ? volume_->shape()
+        : brickShape(volume_->shape(), Volume::Shape(l, l, l),
+                     volume_->chunkShape(), options_.memoryBudget);
+    bricks_ = BW::Blocking<3>(BW::Roi<3>({0,0,0}, volume_->shape()), brick);
+    brick_ = 0;
+}
+
+/**
+ * for every L, read the dataset brick by brick (each brick a multiple of
+ * L^3 and at most options.memoryBudget bytes)
+ */
+bool TgReader::nextBrick(TgChunk& chunk) {
+    using namespace vigra;
+
+    while(!volume_ || brick_ >= bricks_.numBlocks()) {
+        if(volume_ && ++l_ < L.size()) {
+            startBricks();
+            continue;
+        }
+        if(!nextDataset()) {
+            return false;
+        }
+        volumeName_ = ls_[dataset_];
+        volume_ = openVolume(volumeName_);
+        l_ = 0;
+        startBricks();
+    }
+
+    const BW::Roi<3> brickRoi = bricks_[brick_++].second;
+    chunk.dataset = volumeName_;
+    chunk.datasetIndex = dataset_;
+    chunk.volume = bricks_.roi();
+    chunk.roi = brickRoi;
+    chunk.ls = std::vector<int>(1, L[l_]);
+    if(volume_->mapped().hasData()) {
+        chunk.mapped = volume_;
+        return true;
+    }
+    chunk.mapped.reset();
+    // the first brick is the largest one (later ones may be clipped)
+    const Volume::Shape largest = bricks_[0].second.shape();
+    if(chunk.buffer.size() < prod(largest)) {
+        chunk.buffer.reshape(largest);
+    }
+    volume_->read(brickRoi, chunk.data());
+    return true;
+}
+
+} /* anonymous namespace */
+
+void tgStatistics(const std::string& tgFile, const TgOptions& options) {
+    using namespace vigra;
+    using std::cout; using std::endl;
+
+    TgBenchmark benchmark(options);
+    cout << "nthreads = " << benchmark.numThreads() << ", codec threads = " << options.codecThreads << endl;
+    if(options.timing.coldCache && benchmark.numThreads() > 1) {
+        cout << "warning: --coldCache with several threads, workers evict each other's caches" << endl;
+    }
+
+    TgReader reader(tgFile, options);
+    cout << " (" << reader.numDatasets() << " blocks) " << endl;
+    if(options.shard.count > 1) {
+        cout << "shard " << toString(options.shard) << ": "
+             << (reader.shardsBlocks() ? "sub-blocks of all blocks" : "every "
+                 + std::to_string(options.shard.count) + "th block") << endl;
+        if(reader.shardsBlocks()) {
+            benchmark.setBlockShard(options.shard);
+        }
+    }
+
+    // with options.prefetch > 0, the next chunk is read on a background
+    // thread while the current one is being compressed
+    Prefetcher<TgChunk> chunks([&reader](TgChunk& chunk) { return reader.next(chunk); },
+                               options.prefetch);
+    Stopwatch wall;
+    std::string dataset;
+    int l = 0;
+    while(TgChunk* chunk = chunks.next()) {
+        for(int cl : chunk->ls) {
+            if(chunk->dataset != dataset || cl != l) {
+                if(l != 0) { benchmark.endProgress(); }
+                dataset = chunk->dataset;
+                l = cl;
+                benchmark.startDataset(chunk->datasetIndex, l, chunk->volume);
+            }
+            benchmark.run(chunk->data(), chunk->roi, BW::Blocking<3>(chunk->roi, {cl,cl,cl}));
+        }
+    }
+    if(l != 0) { benchmark.endProgress(); }
+    benchmark.close();
+    benchmark.printSelection();
+    benchmark.printCache();
+    cout << "results written to " << options.resultFile
+         << (options.csvFile.empty() ? std::string() : " and " + options.csvFile) << endl;
+    cout << "waited " << chunks.waitMs()/1000.0 << " s of " << wall.elapsedMs()/1000.0
+         << " s for reading" << endl;
+}
@@ -0,0 +1,104 @@
+#ifndef TGSTATISTICS_HXX
+#define TGSTATISTICS_HXX
+
+#include <string>
+#include <vector>
+
+#include "benchmark.hxx"
+#include "codecselector.hxx"
+#include "filters.hxx"
+#include "shards.hxx"
+
+struct TgOptions {
+    TgOptions()
+      : maxBlocks(10)
+      , nthreads(1)
+      , codecThreads(1)
+      , streaming(false)
+      , memoryBudget(size_t(1) << 30)
+      , prefetch(0)
+      , readThreads(1)
+      , filters(1, NO_FILTER)
+      , resultFile("stat.bin")
+      , select(false)
+      , selectSample(0.125)
+      , checkpointSeconds(30.0)
+      , dedup(false)
+      {}
+
+    /** maximum number of tg blocks considered, the first ones by name */
+    int maxBlocks;
+    /** number of worker threads sharing the (sub-block, codec) pairs */
+    int nthreads;
+    /** number of threads each codec may use internally */
+    int codecThreads;
+    /** repetitions and cache mode of every codec measurement */
+    TimingOptions timing;
+    /**
+     * read each dataset in bricks of at most 'memoryBudget' bytes
+     * instead of loading it whole
+     */
+    bool streaming;
+    size_t memoryBudget;
+    /**
+     * number of datasets (or bricks, when streaming) read ahead on a
+     * background thread while the current one is compressed; 0 reads
+     * synchronously
+     */
+    int prefetch;
+    /**
+     * number of threads reading and decoding the chunks of a chunked
+     * volume directory (see RawVolume); HDF5 files are read by one thread
+     */
+    int readThreads;
+    /**
+     * filters applied before each codec; every filter is combined
+     * with every codec
+     */
+    std::vector<Filter> filters;
+    /** columnar binary file receiving one row per (sub-block, codec) */
+    std::string resultFile;
+    /** optional text export of the same rows, empty for none */
+    std::string csvFile;
+    /**
+     * also pick a codec per sub-block with a CodecSelector and compare
+     * the selection with the best single codec, per L
+     */
+    bool select;
+    SelectionObjective objective;
+    /** fraction of the z-slices of a sub-block the selector compresses */
+    double selectSample;
+    /**
+     * measure only this part of the work: with at least shard.count HDF5
+     * blocks, every shard.count-th block (by name) starting at
+     * shard.index; with fewer, all blocks are read and the sub-blocks are
+     * split between the shards
+     */
+    Shard shard;
+    /**
+     * persistent ResultCache: (sub-block, codec) pairs measured by an
+     * earlier (possibly interrupted) run with the same codec threads and
+     * timing options are read from it instead of measured again; empty
+     * for none
+     */
+    std::string cacheFile;
+    /** longest time between two writes of new cache entries */
+    double checkpointSeconds;
+    /**
+     * do not compress uniform sub-blocks and duplicates of earlier
+     * sub-blocks (of the same dataset and L); their results hold the size
+     * of a constant encoding (see ResultRecord::kind)
+     */
+    bool dedup;
+};
+
+/**
+ * compress every sub-block of every topological grid block in 'tgFile'
+ * (an HDF5 file or a directory written by convertTg)
+ * with all codecs from compressorList(), each preceded by every filter
+ * in options.filters, for a range of block sizes L, writing the results
+ * to options.resultFile (see ResultSink)
+ */
+void tgStatistics(const std::string& tgFile, const TgOptions& options);
+
+#endif /* TGSTATISTICS_HXX */
@@ -0,0 +1,133 @@
+#include "threadpool.hxx"
+#include "trace.hxx"
+
+namespace {
+    thread_local const ThreadPool* currentPool = 0;
+    thread_local int currentIndex = -1;
+}
+
+ThreadPool::ThreadPool(int nthreads)
+    : next_(0)
+    , queued_(0)
+    , pending_(0)
+    , stop_(false)
+{
+    if(nthreads < 1) { nthreads = 1; }
+    for(int i=0; i<nthreads; ++i) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+    for(int i=0; i<nthreads; ++i) {
+        threads_.push_back(std::thread(&ThreadPool::run, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for(auto& t : threads_) {
+        t.join();
+    }
+}
+
+int ThreadPool::currentWorker() {
+    return currentIndex;
+}
+
+void ThreadPool::submit(Task task) {
+    size_t w;
+    if(currentPool == this) {
+        w = currentIndex;
+    }
+    else {
+        w = next_++ % queues_.size();
+    }
+    // count the task before publishing it, otherwise a thief could finish
+    // it (and drop pending_ to zero) before it was accounted for
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++queued_;
+        ++pending_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[w]->mutex);
+        queues_[w]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+    if(error_) {
+        std::exception_ptr e = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(e);
+    }
+}
+
+bool ThreadPool::pop(int w, Task& task) {
+    Queue& q = *queues_[w];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if(q.tasks.empty()) {
+        return false;
+    }
+    task = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(int w, Task& task) {
+    const size_t n = queues_.size();
+    for(size_t k=1; k<n; ++k) {
+        Queue& q = *queues_[(w+k) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(q.tasks.empty()) {
+            continue;
+        }
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(int w) {
+    currentPool = this;
+    currentIndex = w;
+    trace::setThreadName("worker " + std::to_string(w));
+    while(true) {
+        Task task;
+        if(pop(w, task) || steal(w, task)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --queued_;
+            }
+            try {
+                TRACE_SPAN("task");
+                task();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(!error_) { error_ = std::current_exception(); }
+            }
+            bool finished;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                finished = (--pending_ == 0);
+            }
+            if(finished) {
+                done_.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+        if(stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
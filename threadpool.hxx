@@ -0,0 +1,85 @@
+#ifndef THREADPOOL_HXX
+#define THREADPOOL_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool.
+ *
+ * Every worker owns a task queue. Tasks submitted from outside the pool are
+ * distributed round-robin over the queues, tasks submitted from within a
+ * running task go to the submitting worker's own queue. A
+ * worker first pops from the back of its own queue (LIFO, keeps the data of
+ * freshly spawned tasks hot) and, if that is empty, steals from the front of
+ * the other workers' queues (FIFO, takes the oldest and largest work first).
+ */
+class ThreadPool {
+    public:
+    typedef std::function<void()> Task;
+
+    /**
+     * start 'nthreads' workers (at least one)
+     */
+    explicit ThreadPool(int nthreads);
+
+    /**
+     * waits for all pending tasks, then joins the workers
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(threads_.size()); }
+
+    /**
+     * enqueue 'task'; may be called from within a running task
+     */
+    void submit(Task task);
+
+    /**
+     * block until all submitted tasks (including tasks spawned by them)
+     * have finished. Rethrows the first exception thrown by a task.
+     *
+     * Must not be called from within a task.
+     */
+    void wait();
+
+    /**
+     * index of the calling worker thread in [0, size()),
+     * or -1 if the caller is not a worker of any pool
+     */
+    static int currentWorker();
+
+    private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(int w, Task& task);
+    bool steal(int w, Task& task);
+    void run(int w);
+
+    std::vector<std::unique_ptr<Queue> > queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    size_t queued_;
+    size_t pending_;
+    bool stop_;
+    std::exception_ptr error_;
+};
+
+#endif /* THREADPOOL_HXX */
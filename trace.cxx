@@ -0,0 +1,233 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "trace.hxx"
+
+namespace trace {
+
+std::atomic<bool> gEnabled(false);
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct Aggregate {
+    const char* name;
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+};
+
+/**
+ * everything one thread records; only that thread writes to it
+ */
+struct ThreadBuffer {
+    ThreadBuffer()
+      : recorded(0)
+      , depth(0)
+      , busyNs(0)
+      {
+          for(int c=0; c<NUM_COUNTERS; ++c) {
+              counters[c] = 0;
+          }
+      }
+
+    std::string name;
+    /** the last ring.size() spans, the oldest at recorded % ring.size() once full */
+    std::vector<Event> ring;
+    size_t recorded;
+    /** number of open spans */
+    int depth;
+    /** time covered by outermost spans */
+    uint64_t busyNs;
+    /** per span name; there are few names, so a linear search is fastest */
+    std::vector<Aggregate> aggregates;
+    uint64_t counters[NUM_COUNTERS];
+};
+
+std::mutex registryMutex;
+// buffers outlive their threads, so that they can be exported at the end
+std::vector<std::unique_ptr<ThreadBuffer> > registry;
+size_t ringSize = 0;
+uint64_t enabledAt = 0;
+
+thread_local ThreadBuffer* current = 0;
+thread_local std::string threadName;
+
+ThreadBuffer& buffer() {
+    if(!current) {
+        std::unique_ptr<ThreadBuffer> b(new ThreadBuffer);
+        std::lock_guard<std::mutex> lock(registryMutex);
+        b->ring.resize(ringSize);
+        b->name = threadName.empty() ? "thread " + std::to_string(registry.size()) : threadName;
+        current = b.get();
+        registry.push_back(std::move(b));
+    }
+    return *current;
+}
+
+std::string escape(const std::string& s) {
+    std::string e;
+    for(char c : s) {
+        if(c == '"' || c == '\\') {
+            e += '\\';
+        }
+        e += c;
+    }
+    return e;
+}
+
+} /* anonymous namespace */
+
+std::string toString(const Counter c) {
+    switch(c) {
+        case BYTES_READ:
+        return "bytesRead";
+        case BYTES_EXTRACTED:
+        return "bytesExtracted";
+        case BYTES_COMPRESSED:
+        return "bytesCompressed";
+        case BYTES_WRITTEN:
+        return "bytesWritten";
+        case ALLOCATIONS:
+        return "allocations";
+        case NUM_COUNTERS:
+        break;
+    }
+    return "";
+}
+
+void enable(size_t eventsPerThread) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    ringSize = std::max<size_t>(1, eventsPerThread);
+    enabledAt = now();
+    gEnabled.store(true);
+}
+
+void setThreadName(const std::string& name) {
+    threadName = name;
+    if(current) {
+        current->name = name;
+    }
+}
+
+uint64_t now() {
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - origin).count();
+}
+
+uint64_t begin() {
+    ++buffer().depth;
+    return now();
+}
+
+void record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& b = buffer();
+    const uint64_t ns = end - start;
+    b.ring[b.recorded % b.ring.size()] = Event{name, start, end};
+    ++b.recorded;
+    if(--b.depth == 0) {
+        b.busyNs += ns;
+    }
+    for(Aggregate& a : b.aggregates) {
+        if(a.name == name) {
+            ++a.count;
+            a.totalNs += ns;
+            a.maxNs = std::max(a.maxNs, ns);
+            return;
+        }
+    }
+    b.aggregates.push_back(Aggregate{name, 1, ns, ns});
+}
+
+void addSlow(Counter c, uint64_t value) {
+    buffer().counters[c] += value;
+}
+
+void writeChromeTrace(const std::string& file) {
+    std::ofstream out(file.c_str(), std::ios::trunc);
+    if(!out) {
+        throw std::runtime_error("trace: cannot open " + file);
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for(size_t t=0; t<registry.size(); ++t) {
+        const ThreadBuffer& b = *registry[t];
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << t << ",\"args\":{\"name\":\"" << escape(b.name) << "\"}}";
+        first = false;
+        const size_t n = std::min(b.recorded, b.ring.size());
+        const size_t oldest = b.recorded - n;
+        for(size_t k=oldest; k<b.recorded; ++k) {
+            const Event& e = b.ring[k % b.ring.size()];
+            out << ",\n{\"name\":\"" << escape(e.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t
+                << std::fixed << std::setprecision(3)
+                << ",\"ts\":" << e.start/1000.0 << ",\"dur\":" << (e.end - e.start)/1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+void printSummary() {
+    using std::cout; using std::endl; using std::setw;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    const double wallMs = (now() - enabledAt)/1e6;
+
+    // the same literal may have different addresses in different files
+    std::map<std::string, Aggregate> spans;
+    uint64_t counters[NUM_COUNTERS] = {0};
+    for(const auto& b : registry) {
+        for(const Aggregate& a : b->aggregates) {
+            auto it = spans.find(a.name);
+            if(it == spans.end()) {
+                spans[a.name] = a;
+                continue;
+            }
+            it->second.count += a.count;
+            it->second.totalNs += a.totalNs;
+            it->second.maxNs = std::max(it->second.maxNs, a.maxNs);
+        }
+        for(int c=0; c<NUM_COUNTERS; ++c) {
+            counters[c] += b->counters[c];
+        }
+    }
+
+    cout << "* trace summary (" << wallMs/1000.0 << " s since tracing started)" << endl;
+    cout << "  " << setw(20) << "span" << setw(12) << "count" << setw(14) << "total [ms]"
+         << setw(14) << "mean [us]" << setw(14) << "max [ms]" << endl;
+    for(const auto& kv : spans) {
+        const Aggregate& a = kv.second;
+        cout << "  " << setw(20) << kv.first << setw(12) << a.count << setw(14) << a.totalNs/1e6
+             << setw(14) << a.totalNs/1e3/a.count << setw(14) << a.maxNs/1e6 << endl;
+    }
+    cout << "  " << setw(20) << "thread" << setw(12) << "spans" << setw(14) << "busy [ms]"
+         << setw(14) << "busy [%]" << setw(14) << "dropped" << endl;
+    for(const auto& b : registry) {
+        const size_t dropped = b->recorded > b->ring.size() ? b->recorded - b->ring.size() : 0;
+        cout << "  " << setw(20) << b->name << setw(12) << b->recorded << setw(14) << b->busyNs/1e6
+             << setw(14) << (wallMs > 0 ? 100.0*b->busyNs/1e6/wallMs : 0.0) << setw(14) << dropped << endl;
+    }
+    for(int c=0; c<NUM_COUNTERS; ++c) {
+        cout << "  " << setw(20) << toString(static_cast<Counter>(c)) << setw(12) << counters[c];
+        if(c != ALLOCATIONS) {
+            cout << " (" << counters[c]/(1024.0*1024.0) << " MB)";
+        }
+        cout << endl;
+    }
+}
+
+} /* namespace trace */
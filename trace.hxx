@@ -0,0 +1,111 @@
+#ifndef TRACE_HXX
+#define TRACE_HXX
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * Low-overhead tracing of scoped spans and counters.
+ *
+ * Every thread records into its own buffers: a ring of the most recent
+ * span events (exported as a Chrome / Perfetto trace) and per-name
+ * aggregates (the summary table), so recording never takes a lock. While
+ * tracing is disabled, which is the default, a span costs one relaxed
+ * load and a branch.
+ *
+ * Export and summary read the buffers of all threads and must only be
+ * called when no thread records any more (e.g. at the end of the run).
+ */
+namespace trace {
+
+/**
+ * counters summed over all threads
+ */
+enum Counter {
+    BYTES_READ,
+    BYTES_EXTRACTED,
+    BYTES_COMPRESSED,
+    BYTES_WRITTEN,
+    ALLOCATIONS,
+    NUM_COUNTERS
+};
+
+std::string toString(const Counter c);
+
+extern std::atomic<bool> gEnabled;
+
+inline bool enabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * start recording, keeping the last 'eventsPerThread' spans of every thread
+ */
+void enable(size_t eventsPerThread = size_t(1) << 18);
+
+/** name of the calling thread in the trace, e.g. "worker 3" */
+void setThreadName(const std::string& name);
+
+/** nanoseconds since the first call */
+uint64_t now();
+
+/** start of a span on the calling thread, returns now() */
+uint64_t begin();
+
+/** end of the span started with begin() at 'start' */
+void record(const char* name, uint64_t start, uint64_t end);
+
+void addSlow(Counter c, uint64_t value);
+
+inline void add(Counter c, uint64_t value) {
+    if(enabled()) {
+        addSlow(c, value);
+    }
+}
+
+/**
+ * records the time from its construction to its destruction under 'name',
+ * which must be a string literal (only the pointer is stored)
+ */
+class Span {
+    public:
+    explicit Span(const char* name)
+        : name_(enabled() ? name : 0)
+        , start_(name_ ? begin() : 0)
+    {}
+
+    ~Span() {
+        if(name_) {
+            record(name_, start_, now());
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    private:
+    const char* name_;
+    uint64_t start_;
+};
+
+/**
+ * write all recorded spans as Chrome trace JSON ("X" events), which
+ * chrome://tracing and ui.perfetto.dev load
+ */
+void writeChromeTrace(const std::string& file);
+
+/**
+ * print per span name the count, total, mean and max time, per thread the
+ * time spent in spans, and the counters
+ */
+void printSummary();
+
+} /* namespace trace */
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+/** trace the rest of the enclosing scope as 'name' */
+#define TRACE_SPAN(name) trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif /* TRACE_HXX */
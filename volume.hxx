@@ -0,0 +1,48 @@
+#ifndef VOLUME_HXX
+#define VOLUME_HXX
+
+#include <cstdint>
+#include <string>
+
+#include <vigra/multi_array.hxx>
+
+#include "roi.h"
+
+/**
+ * A 3-D uint32 volume on disk that is read region by region. Shapes are
+ * in vigra axis order (axis 0 fastest in memory).
+ */
+class Volume {
+    public:
+    typedef vigra::MultiArrayShape<3>::type Shape;
+
+    virtual ~Volume() {}
+
+    virtual const Shape& shape() const = 0;
+
+    /**
+     * shape of the units the volume is stored in; equal to shape() for
+     * contiguous volumes
+     */
+    virtual const Shape& chunkShape() const = 0;
+
+    virtual bool isChunked() const = 0;
+
+    /**
+     * read the voxels of 'roi' into 'out', which must have shape roi.shape()
+     */
+    virtual void read(const BW::Roi<3>& roi, vigra::MultiArrayView<3, uint32_t> out) = 0;
+
+    /** number of payload bytes read so far */
+    virtual size_t bytesRead() const = 0;
+
+    /**
+     * the whole volume, if it is mapped into memory and can be used
+     * without reading (and copying) it; an empty view otherwise
+     */
+    virtual vigra::MultiArrayView<3, uint32_t> mapped() const {
+        return vigra::MultiArrayView<3, uint32_t>();
+    }
+};
+
+#endif /* VOLUME_HXX */